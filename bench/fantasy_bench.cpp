@@ -0,0 +1,423 @@
+// Offline benchmarks for the hot paths of a report run, fed from the recorded responses in bench/fixtures.
+// Results are printed to stdout as one JSON document so runs can be stored and compared over time:
+//
+//     fantasy_bench [--fixtures DIR] [--scale N] [--latency MS] [--bandwidth KBPS] > results.json
+//
+// Nothing here reaches the network: the end-to-end run is served entirely from a pre-seeded HttpCache, and a
+// dead proxy is configured so a cache miss fails instead of going out. The replayed end-to-end run serves the same
+// responses from an HTTP archive with simulated latency and bandwidth (50 ms and 2048 KB/s by default).
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../draft_parser.h"
+#include "../draft_store.h"
+#include "../fantasy.h"
+#include "../http_archive.h"
+#include "../http_cache.h"
+#include "../http_client.h"
+#include "../name_matching.h"
+#include "../pipeline.h"
+#include "../players_ingest.h"
+#include "../text_normalize.h"
+
+
+#ifndef FIXTURE_DIR
+#define FIXTURE_DIR "bench/fixtures"
+#endif
+
+namespace fs = std::filesystem;
+
+static const int fixtureYears[] = {2022, 2023, 2024};
+
+struct Fixtures {
+    std::string players;
+    std::string users;
+    std::string rosters;
+    std::vector<std::pair<int, std::string>> draftPages;
+    std::vector<std::pair<int, std::string>> draftWikitext; // action=raw source of the same pages
+};
+
+static std::string readFile(const fs::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("missing fixture " + path.string());
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static Fixtures loadFixtures(const fs::path &dir) {
+    Fixtures fixtures;
+    fixtures.players = readFile(dir / "players_nfl.json");
+    fixtures.users = readFile(dir / "league_users.json");
+    fixtures.rosters = readFile(dir / "league_rosters.json");
+    for (int year: fixtureYears) {
+        fixtures.draftPages.emplace_back(year, readFile(dir / (std::to_string(year) + "_NFL_draft.html")));
+        fixtures.draftWikitext.emplace_back(year, readFile(dir / (std::to_string(year) + "_NFL_draft.wikitext")));
+    }
+    return fixtures;
+}
+
+// Runs body iterations times and records the wall time; rates are filled in by the caller per iteration
+class Benchmark {
+public:
+    Benchmark(std::string name, size_t iterations)
+        : name(std::move(name)), iterations(std::max<size_t>(1, iterations)) {}
+
+    template<typename F>
+    double run(F &&body) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds / (double) iterations;
+    }
+
+    void rate(const std::string &unit, double perIteration) {
+        rates[unit + "_per_s"] = perIteration * (double) iterations / seconds;
+    }
+    void nanosPer(const std::string &unit, double perIteration) {
+        rates["ns_per_" + unit] = seconds * 1e9 / (perIteration * (double) iterations);
+    }
+
+    nlohmann::json toJson() const {
+        nlohmann::json result = {{"name", name}, {"iterations", iterations}, {"seconds", seconds},
+                                 {"seconds_per_iteration", seconds / (double) iterations}};
+        for (const auto &[unit, value]: rates) {
+            result[unit] = value;
+        }
+        return result;
+    }
+
+private:
+    std::string name;
+    size_t iterations;
+    double seconds = 0;
+    std::map<std::string, double> rates;
+};
+
+static std::vector<DraftPick> allFixturePicks(const Fixtures &fixtures, DraftSource source = DraftSource::Html) {
+    std::vector<DraftPick> picks;
+    for (const auto &[year, page]: source == DraftSource::Html ? fixtures.draftPages : fixtures.draftWikitext) {
+        parseDraftTable(year, page, [&picks](const DraftPick &pick) { picks.push_back(pick); }, source);
+    }
+    return picks;
+}
+
+static bool samePicks(const std::vector<DraftPick> &a, const std::vector<DraftPick> &b) {
+    return std::ranges::equal(a, b, [](const DraftPick &x, const DraftPick &y) {
+        return x.year == y.year && x.round == y.round && x.pick == y.pick && x.team == y.team &&
+               x.player_name == y.player_name;
+    });
+}
+
+static Benchmark benchPlayersIngest(const Fixtures &fixtures, size_t iterations, IngestMode mode) {
+    const char *name = mode == IngestMode::Full ? "players_json_ingest_full"
+                     : mode == IngestMode::Bulk ? "players_json_ingest_bulk"
+                                                : "players_json_ingest_unchanged";
+    Benchmark bench(name, iterations);
+
+    SQLite::Database db(":memory:", SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+    std::vector<std::string> columns;
+    PlayerChanges changes;
+    if (mode == IngestMode::Incremental) {
+        ingestPlayersJson(db, fixtures.players, columns, changes, IngestMode::Full);
+    }
+
+    size_t rows = 0;
+    bench.run([&] {
+        SQLite::Transaction transaction(db);
+        changes = {};
+        ingestPlayersJson(db, fixtures.players, columns, changes, mode);
+        transaction.commit();
+        rows = changes.inserted.size() + changes.updated.size() + changes.unchanged;
+    });
+    bench.rate("mb", (double) fixtures.players.size() / 1e6);
+    bench.rate("players", (double) rows);
+    return bench;
+}
+
+static Benchmark benchDraftInsert(const std::vector<DraftPick> &picks, size_t iterations) {
+    Benchmark bench("sqlite_draft_insert", iterations);
+
+    SQLite::Database db(":memory:", SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+    createDraftTables(db);
+    bench.run([&] { storeDraftYear(db, picks.front().year, picks, true); });
+    bench.rate("rows", (double) picks.size());
+    return bench;
+}
+
+static Benchmark benchTableExtraction(const Fixtures &fixtures, size_t iterations, DraftSource source) {
+    Benchmark bench(source == DraftSource::Html ? "draft_table_extract" : "draft_wikitext_extract", iterations);
+
+    size_t bytes = 0;
+    size_t picks = 0;
+    bench.run([&] {
+        bytes = 0;
+        picks = 0;
+        for (const auto &[year, page]: source == DraftSource::Html ? fixtures.draftPages : fixtures.draftWikitext) {
+            parseDraftTable(year, page, [&picks](const DraftPick &) { picks++; }, source);
+            bytes += page.size();
+        }
+    });
+    bench.rate("mb", (double) bytes / 1e6);
+    bench.rate("picks", (double) picks);
+    return bench;
+}
+
+static Benchmark benchNormalize(const std::vector<DraftPick> &picks, size_t iterations) {
+    Benchmark bench("normalize_name", iterations);
+
+    std::string buffer;
+    size_t checksum = 0;
+    bench.run([&] {
+        for (const auto &pick: picks) {
+            normalizeName(pick.player_name, buffer);
+            checksum += buffer.size();
+        }
+    });
+    bench.nanosPer("pick", (double) picks.size());
+    std::cerr << "normalize checksum " << checksum << std::endl;
+    return bench;
+}
+
+static Benchmark benchMatch(const Fixtures &fixtures, const std::vector<DraftPick> &picks, size_t iterations) {
+    Benchmark bench("match_pick", iterations);
+
+    std::vector<std::string> names;
+    for (const auto &player: nlohmann::json::parse(fixtures.players)) {
+        names.push_back(player.value("full_name", ""));
+    }
+    NameIndex index;
+    index.build(names);
+
+    size_t matched = 0;
+    bench.run([&] {
+        matched = 0;
+        for (const auto &pick: picks) {
+            matched += index.findFirst(pick.player_name) >= 0;
+        }
+    });
+    bench.nanosPer("pick", (double) picks.size());
+    bench.rate("picks", (double) picks.size());
+    std::cerr << "matched " << matched << " of " << picks.size() << " picks" << std::endl;
+    return bench;
+}
+
+// The second matching tier over the picks the NameIndex leaves unmatched
+static Benchmark benchFuzzyMatch(const Fixtures &fixtures, const std::vector<DraftPick> &picks, size_t iterations) {
+    Benchmark bench("match_pick_fuzzy", iterations);
+
+    std::vector<std::string> names;
+    std::vector<std::string> positions;
+    std::vector<int> yearsExp;
+    for (const auto &player: nlohmann::json::parse(fixtures.players)) {
+        names.push_back(cleanName(player.value("full_name", "")));
+        positions.push_back(player.value("position", ""));
+        yearsExp.push_back(player.contains("years_exp") && player["years_exp"].is_number_integer()
+                                   ? player["years_exp"].get<int>()
+                                   : 0);
+    }
+    NameIndex index;
+    index.buildNormalized(names);
+    FuzzyNameMatcher fuzzy;
+    fuzzy.build(names, positions, yearsExp, getCurrentYear());
+
+    std::vector<DraftPick> leftover;
+    for (const auto &pick: picks) {
+        if (index.findFirst(pick.player_name) < 0) {
+            leftover.push_back(pick);
+        }
+    }
+
+    size_t accepted = 0;
+    size_t ambiguous = 0;
+    bench.run([&] {
+        accepted = 0;
+        ambiguous = 0;
+        for (const auto &pick: leftover) {
+            FuzzyMatch match = fuzzy.find(pick.player_name, pick.position, pick.year);
+            accepted += match.accepted;
+            ambiguous += match.ambiguous;
+        }
+    });
+    bench.nanosPer("pick", (double) leftover.size());
+    bench.rate("picks", (double) leftover.size());
+    std::cerr << "fuzzy matched " << accepted << " and found " << ambiguous << " ambiguous of " << leftover.size()
+              << " unmatched picks" << std::endl;
+    return bench;
+}
+
+// Same stages as main(), against a fresh database and an HttpCache holding every URL the run will request.
+// With timing the responses are replayed from an archive of the fixtures over the simulated network instead of
+// being served by the cache
+// What action=raw&section=N returns for the fixture's picks section: its heading through the next heading
+static std::string picksSection(const std::string &wikitext) {
+    size_t start = wikitext.find("== Player selections ==");
+    if (start == std::string::npos) {
+        return wikitext;
+    }
+    size_t end = wikitext.find("\n== ", start);
+    return wikitext.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+static Benchmark benchEndToEnd(const Fixtures &fixtures, size_t iterations, const ReplayTiming *timing = nullptr) {
+    Benchmark bench(timing ? "end_to_end_replay" : "end_to_end", iterations);
+
+    fs::path workDir = fs::temp_directory_path() / "fantasy_bench";
+    fs::remove_all(workDir);
+    fs::create_directories(workDir);
+
+    const std::string leagueId = "bench";
+    HttpCache cache(workDir / "http_cache");
+    cache.setTtl("https://", std::chrono::hours(24 * 365));
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+    HttpArchiveWriter recorder;
+    if (timing) {
+        recorder.open(workDir / "fixtures.archive");
+    }
+    auto seed = [&](const std::string &url, const std::string &body) {
+        cache.store({url, "", "", now}, body);
+        recorder.add(url, 200, "", body);
+    };
+    seed("https://api.sleeper.app/v1/players/nfl", fixtures.players);
+    seed("https://api.sleeper.app/v1/league/" + leagueId + "/users", fixtures.users);
+    seed("https://api.sleeper.app/v1/league/" + leagueId + "/rosters", fixtures.rosters);
+
+    // Every year in the run's range is served one of the recorded pages, in every form, with the picks as section 1
+    const std::string sectionsResponse =
+            R"({"parse":{"sections":[{"level":"2","line":"Player selections","index":"1"}]}})";
+    int currentYear = getCurrentYear();
+    for (int year = currentYear - 40; year <= currentYear; ++year) {
+        size_t fixture = (size_t) year % fixtures.draftPages.size();
+        const std::string &wikitext = fixtures.draftWikitext[fixture].second;
+        seed(draftPageUrl(year, DraftSource::Html), fixtures.draftPages[fixture].second);
+        seed(draftPageUrl(year, DraftSource::Wikitext), wikitext);
+        seed(draftSectionsUrl(year), sectionsResponse);
+        seed(draftPageUrl(year, DraftSource::Wikitext, 1), picksSection(wikitext));
+    }
+
+    HttpClient http;
+    http.setCache(&cache);
+    HttpArchive archive;
+    if (timing) {
+        if (!recorder.close() || !archive.open(workDir / "fixtures.archive")) {
+            throw std::runtime_error("cannot write the fixture archive");
+        }
+        http.setReplay(&archive, *timing);
+    }
+    ThreadPool pool(4);
+
+    std::ostringstream discarded;
+    auto *coutBuffer = std::cout.rdbuf(discarded.rdbuf());
+
+    size_t drafted = 0;
+    bench.run([&] {
+        fs::remove(workDir / "fantasy_league.db");
+        SQLite::Database db((workDir / "fantasy_league.db").string(), SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+        configureDatabase(db);
+
+        createLeagueTables(db);
+        fetchSleeperData(db, pool, http, {leagueId}, true);
+        storePlayersInMemory(db, leagueId);
+
+        createDraftTables(db);
+        loadDraftInformation(db, pool, http);
+
+        createProcessedPlayersTable(db);
+        storeProcessedPlayers(db, leagueId);
+        drafted = 0;
+        for (size_t i = 0; i < players.size(); ++i) {
+            drafted += players.isDrafted(i);
+        }
+        discarded.str({});
+    });
+
+    std::cout.rdbuf(coutBuffer);
+    fs::remove_all(workDir);
+
+    bench.rate("runs", 1);
+    std::cerr << (timing ? "end to end replay: " : "end to end: ") << players.size() << " players, " << drafted
+              << " drafted" << std::endl;
+    return bench;
+}
+
+int main(int argc, char **argv) {
+    fs::path fixtureDir = FIXTURE_DIR;
+    size_t scale = 1;
+    // Simulated network for the replayed end-to-end run
+    ReplayTiming timing{std::chrono::milliseconds(50), 2048 * 1024.0};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--fixtures" && i + 1 < argc) {
+            fixtureDir = argv[++i];
+        } else if (arg == "--scale" && i + 1 < argc) {
+            scale = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--latency" && i + 1 < argc) {
+            timing.latency = std::chrono::milliseconds(std::stoul(argv[++i]));
+        } else if (arg == "--bandwidth" && i + 1 < argc) {
+            timing.bytesPerSecond = (double) std::stoul(argv[++i]) * 1024.0;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--fixtures DIR] [--scale N] [--latency MS] [--bandwidth KBPS]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    // Any request the cache cannot answer fails against this instead of reaching the real host
+    setenv("ALL_PROXY", "http://127.0.0.1:9", 1);
+    setenv("HTTPS_PROXY", "http://127.0.0.1:9", 1);
+
+    try {
+        Fixtures fixtures = loadFixtures(fixtureDir);
+        std::vector<DraftPick> picks = allFixturePicks(fixtures);
+        if (picks.empty()) {
+            std::cerr << "No picks found in the draft fixtures" << std::endl;
+            return 1;
+        }
+        if (!samePicks(picks, allFixturePicks(fixtures, DraftSource::Wikitext))) {
+            std::cerr << "The wikitext fixtures do not yield the same picks as the HTML fixtures" << std::endl;
+            return 1;
+        }
+
+        nlohmann::json results = nlohmann::json::array();
+        results.push_back(benchPlayersIngest(fixtures, 5 * scale, IngestMode::Full).toJson());
+        results.push_back(benchPlayersIngest(fixtures, 5 * scale, IngestMode::Bulk).toJson());
+        results.push_back(benchPlayersIngest(fixtures, 5 * scale, IngestMode::Incremental).toJson());
+        results.push_back(benchDraftInsert(picks, 50 * scale).toJson());
+        results.push_back(benchTableExtraction(fixtures, 20 * scale, DraftSource::Html).toJson());
+        results.push_back(benchTableExtraction(fixtures, 20 * scale, DraftSource::Wikitext).toJson());
+        results.push_back(benchNormalize(picks, 2000 * scale).toJson());
+        results.push_back(benchMatch(fixtures, picks, 2000 * scale).toJson());
+        results.push_back(benchFuzzyMatch(fixtures, picks, 200 * scale).toJson());
+        results.push_back(benchEndToEnd(fixtures, 3 * scale).toJson());
+        results.push_back(benchEndToEnd(fixtures, scale, &timing).toJson());
+
+        nlohmann::json report = {
+                {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
+                                      std::chrono::system_clock::now().time_since_epoch()).count()},
+                {"fixtures", fs::absolute(fixtureDir).string()},
+                {"scale", scale},
+                {"benchmarks", results},
+        };
+        std::cout << report.dump(2) << std::endl;
+
+    } catch (std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
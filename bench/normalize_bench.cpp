@@ -0,0 +1,79 @@
+// Compares normalizeText/normalizeName against the std::regex pipeline fetchDraftInformation used to run on
+// every draft table cell and player name.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "../text_normalize.h"
+
+
+static std::string legacyCleanName(const std::string &name) {
+    std::string cleaned = name;
+
+    std::erase(cleaned, '\xC2');
+    std::erase(cleaned, '\xA0');
+
+    while (!cleaned.empty() && std::isspace(cleaned.back())) {
+        cleaned.pop_back();
+    }
+
+    std::ranges::transform(cleaned, cleaned.begin(), [](unsigned char c) { return std::tolower(c); });
+    return cleaned;
+}
+
+static std::string legacyNormalize(const std::string &content) {
+    std::string cellContent = content;
+    std::erase(cellContent, '\n');
+    cellContent = std::regex_replace(cellContent, std::regex("\\s+"), " ");
+    cellContent = std::regex_replace(cellContent, std::regex("^ +| +$"), "");
+
+    std::string player_name = legacyCleanName(cellContent);
+    player_name = std::regex_replace(player_name, std::regex("<[^>]*>"), "");
+    player_name = std::regex_replace(player_name, std::regex("&nbsp;"), " ");
+    player_name = std::regex_replace(player_name, std::regex("[†‡*]"), "");
+    player_name = std::regex_replace(player_name, std::regex("^ +| +$"), "");
+    return player_name;
+}
+
+template<typename F>
+static double nanosPerCall(size_t iterations, F &&body) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double) iterations;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    const std::vector<std::string> cells = {
+            "\n Patrick Mahomes\n",
+            "Ja'Marr\xC2\xA0" "Chase\xE2\x80\xA0",
+            "  Amon-Ra   St. Brown  ",
+            "Jos\xC3\xA9 Ram\xC3\xADrez*",
+            "<span>Bijan Robinson</span>&nbsp;",
+            "Kansas City Chiefs",
+            "Travis Etienne\xE2\x80\xA1",
+            "Christian McCaffrey",
+    };
+
+    size_t sink = 0;
+    double legacy = nanosPerCall(iterations, [&](size_t i) { sink += legacyNormalize(cells[i % cells.size()]).size(); });
+
+    std::string buffer;
+    double single = nanosPerCall(iterations, [&](size_t i) {
+        normalizeName(cells[i % cells.size()], buffer);
+        sink += buffer.size();
+    });
+
+    std::cout << "regex pipeline:     " << legacy << " ns/name\n";
+    std::cout << "normalizeName:      " << single << " ns/name\n";
+    std::cout << "speedup:            " << legacy / single << "x\n";
+    std::cout << "(checksum " << sink << ")\n";
+    return 0;
+}
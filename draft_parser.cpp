@@ -0,0 +1,442 @@
+#include "draft_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <string_view>
+
+#include "text_normalize.h"
+
+
+static bool nameIs(const xmlChar *name, const char *expected) {
+    return xmlStrcmp(name, (const xmlChar *) expected) == 0;
+}
+
+// Same test as //table[contains(@class, 'wikitable') and contains(@class, 'sortable') and
+// contains(@class, 'plainrowheaders')]
+static bool hasPicksTableClasses(std::string_view classes) {
+    return classes.find("wikitable") != std::string_view::npos &&
+           classes.find("sortable") != std::string_view::npos &&
+           classes.find("plainrowheaders") != std::string_view::npos;
+}
+
+static bool isPicksTable(const xmlChar **attrs) {
+    for (; attrs != nullptr && attrs[0] != nullptr; attrs += 2) {
+        if (nameIs(attrs[0], "class") && attrs[1] != nullptr) {
+            return hasPicksTableClasses((const char *) attrs[1]);
+        }
+    }
+    return false;
+}
+
+// Rows with at least five cells and a numeric round and pick: the round is in cell 1, the pick in 2, the team
+// in 3, the player in 4 and the position in 5, after the colour-key cell
+static bool makePick(int year, const std::vector<std::string> &cells, DraftPick &pick) {
+    if (cells.size() < 5) {
+        return false;
+    }
+    try {
+        pick.round = std::stoi(cells[1]);
+        pick.pick = std::stoi(cells[2]);
+    } catch (const std::exception &) {
+        return false; // header and separator rows have no numeric round/pick
+    }
+    pick.year = year;
+    pick.team = cells[3];
+    pick.player_name = cells[4];
+    pick.position = cells.size() > 5 ? cells[5] : "";
+    return true;
+}
+
+static htmlSAXHandler makeSaxHandler(startElementSAXFunc start, endElementSAXFunc end, charactersSAXFunc chars) {
+    htmlSAXHandler handler;
+    std::memset(&handler, 0, sizeof(handler));
+    handler.startElement = start;
+    handler.endElement = end;
+    handler.characters = chars;
+    handler.ignorableWhitespace = chars;
+    handler.cdataBlock = chars;
+    return handler;
+}
+
+DraftTableParser::DraftTableParser(int year, PickHandler onPick) : year(year), onPick(std::move(onPick)) {
+    static htmlSAXHandler saxHandler = makeSaxHandler(onStartElement, onEndElement, onCharacters);
+
+    std::string url = draftPageUrl(year, DraftSource::Html);
+    parser = htmlCreatePushParserCtxt(&saxHandler, this, nullptr, 0, url.c_str(), XML_CHAR_ENCODING_NONE);
+    if (parser != nullptr) {
+        htmlCtxtUseOptions(parser, HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_NONET);
+    }
+}
+
+DraftTableParser::~DraftTableParser() {
+    if (parser != nullptr) {
+        if (parser->myDoc != nullptr) {
+            xmlFreeDoc(parser->myDoc);
+        }
+        htmlFreeParserCtxt(parser);
+    }
+}
+
+void DraftTableParser::feed(const char *data, size_t size) {
+    // Once the table has closed the rest of the page is dropped unparsed
+    if (parser == nullptr || tableDone || size == 0) {
+        return;
+    }
+    htmlParseChunk(parser, data, (int) size, 0);
+}
+
+void DraftTableParser::finish() {
+    if (parser == nullptr || tableDone) {
+        return;
+    }
+    htmlParseChunk(parser, nullptr, 0, 1);
+}
+
+void DraftTableParser::onStartElement(void *ctx, const xmlChar *name, const xmlChar **attrs) {
+    auto *self = static_cast<DraftTableParser *>(ctx);
+    int depth = ++self->depth;
+
+    if (self->tableDone) {
+        return;
+    }
+    if (self->tableDepth == 0) {
+        if (nameIs(name, "table") && isPicksTable(attrs)) {
+            self->tableDepth = depth;
+        }
+        return;
+    }
+
+    // Only the first tbody of the table, its rows and their cells count, as in the DOM walk this replaces
+    if (depth == self->tableDepth + 1 && nameIs(name, "tbody") && self->tbodyDepth == 0) {
+        self->tbodyDepth = depth;
+    } else if (self->tbodyDepth > 0 && depth == self->tbodyDepth + 1 && nameIs(name, "tr")) {
+        self->rowDepth = depth;
+        self->rowData.clear();
+    } else if (self->rowDepth > 0 && depth == self->rowDepth + 1 && (nameIs(name, "td") || nameIs(name, "th"))) {
+        self->cellDepth = depth;
+        self->cellText.clear();
+    }
+}
+
+void DraftTableParser::onEndElement(void *ctx, const xmlChar *) {
+    auto *self = static_cast<DraftTableParser *>(ctx);
+    int depth = self->depth--;
+
+    if (self->tableDepth == 0 || self->tableDone) {
+        return;
+    }
+
+    if (depth == self->cellDepth) {
+        normalizeText(self->cellText, self->rowData.emplace_back());
+        self->cellDepth = 0;
+    } else if (depth == self->rowDepth) {
+        self->endRow();
+        self->rowDepth = 0;
+    } else if (depth == self->tbodyDepth) {
+        // A later tbody is not part of the picks; mark the body as consumed
+        self->tbodyDepth = -1;
+    } else if (depth == self->tableDepth) {
+        self->tableDone = true;
+        xmlStopParser(self->parser);
+    }
+}
+
+void DraftTableParser::onCharacters(void *ctx, const xmlChar *text, int length) {
+    auto *self = static_cast<DraftTableParser *>(ctx);
+    if (self->cellDepth > 0) {
+        self->cellText.append((const char *) text, (size_t) length);
+    }
+}
+
+void DraftTableParser::endRow() {
+    rowCount++;
+    if (DraftPick pick; makePick(year, rowData, pick)) {
+        onPick(pick);
+    }
+}
+
+// Start of the text after the bracket pair ("[[...]]" or "{{...}}") opening at start, or npos if it never closes
+static size_t findClosing(std::string_view text, size_t start, char open, char close) {
+    int depth = 0;
+    for (size_t i = start; i + 1 < text.size(); ++i) {
+        if (text[i] == open && text[i + 1] == open) {
+            depth++;
+            i++;
+        } else if (text[i] == close && text[i + 1] == close) {
+            if (--depth == 0) {
+                return i + 2;
+            }
+            i++;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Splits on separator outside links and templates, so "[[a|b]]" and "{{sortname|a|b}}" stay whole
+static std::vector<std::string_view> splitTopLevel(std::string_view text, std::string_view separator) {
+    std::vector<std::string_view> parts;
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        std::string_view rest = text.substr(i);
+        if (rest.starts_with("[[") || rest.starts_with("{{")) {
+            depth++;
+            i++;
+        } else if (depth > 0 && (rest.starts_with("]]") || rest.starts_with("}}"))) {
+            depth--;
+            i++;
+        } else if (depth == 0 && rest.starts_with(separator)) {
+            parts.push_back(text.substr(start, i - start));
+            start = i + separator.size();
+            i = start - 1;
+        }
+    }
+    parts.push_back(text.substr(start));
+    return parts;
+}
+
+static void appendWikiText(std::string_view text, std::string &out);
+
+// The templates that put text in a picks row; every other template (efn, refs, icons) renders nothing we keep
+static void appendTemplate(std::string_view inner, std::string &out) {
+    std::vector<std::string_view> params = splitTopLevel(inner, "|");
+    std::string name;
+    normalizeName(params[0], name);
+
+    std::vector<std::string_view> positional;
+    for (size_t i = 1; i < params.size(); ++i) {
+        if (params[i].find('=') >= params[i].find_first_of("[{")) {
+            positional.push_back(params[i]);
+        }
+    }
+
+    if (name == "sortname" && positional.size() >= 2) {
+        appendWikiText(positional[0], out);
+        out += ' ';
+        appendWikiText(positional[1], out);
+    } else if (name == "dagger") {
+        out += "†";
+    } else if (name == "double-dagger" || name == "double dagger") {
+        out += "‡";
+    } else if ((name == "nowrap" || name == "small") && !positional.empty()) {
+        appendWikiText(positional[0], out);
+    }
+}
+
+// Reduces cell markup to its displayed text: links become their label, quotes, comments and references
+// disappear, and templates go through appendTemplate. HTML tags and entities are left for normalizeText.
+static void appendWikiText(std::string_view text, std::string &out) {
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t next = text.find_first_of("<[{'", i);
+        if (next == std::string_view::npos) {
+            out += text.substr(i);
+            return;
+        }
+        out += text.substr(i, next - i);
+        i = next;
+
+        std::string_view rest = text.substr(i);
+        if (rest.starts_with("<!--")) {
+            size_t end = rest.find("-->");
+            i = end == std::string_view::npos ? text.size() : i + end + 3;
+        } else if (rest.starts_with("<ref")) {
+            size_t close = rest.find('>');
+            size_t end = close == std::string_view::npos || rest[close - 1] == '/' ? close : rest.find("</ref>");
+            i = end == std::string_view::npos ? text.size() : i + (end == close ? close + 1 : end + 6);
+        } else if (rest.starts_with("[[")) {
+            size_t end = findClosing(text, i, '[', ']');
+            if (end == std::string_view::npos) {
+                out += rest;
+                return;
+            }
+            std::string_view link = text.substr(i + 2, end - i - 4);
+            if (!link.starts_with("File:") && !link.starts_with("Image:")) {
+                appendWikiText(splitTopLevel(link, "|").back(), out);
+            }
+            i = end;
+        } else if (rest.starts_with("{{")) {
+            size_t end = findClosing(text, i, '{', '}');
+            if (end == std::string_view::npos) {
+                return;
+            }
+            appendTemplate(text.substr(i + 2, end - i - 4), out);
+            i = end;
+        } else if (rest.starts_with("''")) {
+            i = std::min(text.find_first_not_of('\'', i), text.size());
+        } else if (rest.starts_with("[http://") || rest.starts_with("[https://")) {
+            size_t end = rest.find(']');
+            if (end == std::string_view::npos) {
+                out += rest;
+                return;
+            }
+            size_t space = rest.find(' ');
+            if (space < end) {
+                appendWikiText(rest.substr(space + 1, end - space - 1), out);
+            }
+            i += end + 1;
+        } else {
+            out += text[i++];
+        }
+    }
+}
+
+DraftWikitextParser::DraftWikitextParser(int year, PickHandler onPick) : year(year), onPick(std::move(onPick)) {}
+
+void DraftWikitextParser::feed(const char *data, size_t size) {
+    if (tableDone || size == 0) {
+        return;
+    }
+    std::string_view chunk(data, size);
+    size_t start = 0;
+    for (size_t end; !tableDone && (end = chunk.find('\n', start)) != std::string_view::npos; start = end + 1) {
+        if (pending.empty()) {
+            parseLine(chunk.substr(start, end - start));
+        } else {
+            pending += chunk.substr(start, end - start);
+            parseLine(pending);
+            pending.clear();
+        }
+    }
+    if (!tableDone) {
+        pending += chunk.substr(start);
+    }
+}
+
+void DraftWikitextParser::finish() {
+    if (!tableDone && !pending.empty()) {
+        parseLine(pending);
+    }
+    pending.clear();
+    if (inTable) {
+        endRow(); // a page cut off before "|}" still yields its last row
+    }
+}
+
+void DraftWikitextParser::parseLine(std::string_view line) {
+    if (line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    size_t first = line.find_first_not_of(" \t");
+    std::string_view text = first == std::string_view::npos ? std::string_view() : line.substr(first);
+
+    if (!inTable) {
+        inTable = text.starts_with("{|") && hasPicksTableClasses(text);
+        return;
+    }
+
+    // A table nested in a cell is not part of the row structure
+    if (text.starts_with("{|")) {
+        nestedTables++;
+        return;
+    }
+    if (nestedTables > 0) {
+        if (text.starts_with("|}")) {
+            nestedTables--;
+        }
+        return;
+    }
+
+    if (text.starts_with("|}")) {
+        endRow();
+        inTable = false;
+        tableDone = true;
+    } else if (text.starts_with("|-")) {
+        endRow();
+    } else if (text.starts_with("|+")) {
+        return; // caption
+    } else if (text.starts_with("!")) {
+        addCells(text.substr(1), "!!");
+    } else if (text.starts_with("|")) {
+        addCells(text.substr(1), "||");
+    } else if (!rowData.empty()) {
+        // Cell content continues until the next cell or row marker
+        rowData.back() += '\n';
+        rowData.back() += line;
+    }
+}
+
+void DraftWikitextParser::addCells(std::string_view line, std::string_view separator) {
+    for (std::string_view cell: splitTopLevel(line, separator)) {
+        // Header lines may also separate cells with "||"
+        std::vector<std::string_view> cells = separator == "||" ? std::vector{cell} : splitTopLevel(cell, "||");
+        for (std::string_view content: cells) {
+            // "attributes | content"
+            std::vector<std::string_view> parts = splitTopLevel(content, "|");
+            if (parts.size() > 1) {
+                content.remove_prefix(parts[0].size() + 1);
+            }
+            rowData.emplace_back(content);
+        }
+    }
+}
+
+void DraftWikitextParser::endRow() {
+    if (rowData.empty()) {
+        return;
+    }
+    rowCount++;
+
+    // Only the cells makePick reads are converted
+    std::string text;
+    for (size_t i = 0; i < rowData.size() && i < 6; ++i) {
+        text.clear();
+        appendWikiText(rowData[i], text);
+        normalizeText(text, rowData[i]);
+    }
+    if (DraftPick pick; makePick(year, rowData, pick)) {
+        onPick(pick);
+    }
+    rowData.clear();
+}
+
+std::string draftPageUrl(int year, DraftSource source, int section) {
+    std::string title = std::to_string(year) + "_NFL_draft";
+    if (source == DraftSource::Wikitext) {
+        return "https://en.wikipedia.org/w/index.php?title=" + title + "&action=raw" +
+               (section > 0 ? "&section=" + std::to_string(section) : "");
+    }
+    return "https://en.wikipedia.org/wiki/" + title;
+}
+
+std::string draftSectionsUrl(int year) {
+    return "https://en.wikipedia.org/w/api.php?action=parse&format=json&prop=sections&page=" + std::to_string(year) +
+           "_NFL_draft";
+}
+
+// Articles number their sections differently from year to year, but the picks are always under a top-level
+// "Player selections" heading (or a close variant)
+int findPicksSection(const std::string &sectionsResponse) {
+    nlohmann::json response = nlohmann::json::parse(sectionsResponse, nullptr, false);
+    if (!response.is_object() || !response.contains("parse") || !response["parse"].contains("sections")) {
+        return 0;
+    }
+    for (const auto &section: response["parse"]["sections"]) {
+        std::string line = section.value("line", "");
+        std::ranges::transform(line, line.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+        std::string index = section.value("index", "");
+        // Sections transcluded from templates have indices like "T-1" that action=raw cannot address
+        if (section.value("level", "") != "2" || line.find("selections") == std::string::npos || index.empty() ||
+            !std::ranges::all_of(index, [](unsigned char c) { return std::isdigit(c); })) {
+            continue;
+        }
+        return std::stoi(index);
+    }
+    return 0;
+}
+
+std::unique_ptr<DraftPageParser> makeDraftParser(int year, DraftSource source, DraftPageParser::PickHandler onPick) {
+    if (source == DraftSource::Wikitext) {
+        return std::make_unique<DraftWikitextParser>(year, std::move(onPick));
+    }
+    return std::make_unique<DraftTableParser>(year, std::move(onPick));
+}
+
+void parseDraftTable(int year, const std::string &page, const DraftPageParser::PickHandler &onPick,
+                     DraftSource source) {
+    std::unique_ptr<DraftPageParser> parser = makeDraftParser(year, source, onPick);
+    parser->feed(page.data(), page.size());
+    parser->finish();
+}
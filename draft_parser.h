@@ -0,0 +1,124 @@
+#ifndef DRAFT_PARSER_H
+#define DRAFT_PARSER_H
+
+#include <functional>
+#include <libxml/HTMLparser.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+struct DraftPick {
+    int year;
+    int round;
+    int pick;
+    std::string team;
+    std::string player_name; // cell text, normalized but not case-folded
+    std::string position;    // as listed in the table ("QB", "OT", "OLB"), empty when the page has no column
+};
+
+// Where the picks of a draft year are read from: the rendered article, or its raw wikitext, which is a fraction
+// of the size and needs no HTML parsing
+enum class DraftSource { Html, Wikitext };
+
+// With a section index, the wikitext of that section only instead of the whole article
+std::string draftPageUrl(int year, DraftSource source, int section = 0);
+
+// The article's table of contents from the MediaWiki API, a few hundred bytes
+std::string draftSectionsUrl(int year);
+
+// Index of the section holding the picks table in a draftSectionsUrl() response, 0 when it has none
+int findPicksSection(const std::string &sectionsResponse);
+
+// Streaming extractor for the picks table of one draft page. Chunks are fed as they arrive, picks are emitted
+// row by row, and the rest of the page is dropped once the table closes.
+class DraftPageParser {
+public:
+    using PickHandler = std::function<void(const DraftPick &pick)>;
+
+    virtual ~DraftPageParser() = default;
+
+    virtual void feed(const char *data, size_t size) = 0;
+    virtual void finish() = 0;
+
+    virtual bool foundTable() const = 0;
+    virtual int getRowCount() const = 0;
+};
+
+// Extractor for the rendered "<year>_NFL_draft" article. Chunks are pushed through a libxml2 HTML SAX parser, so
+// the document tree is never built.
+class DraftTableParser : public DraftPageParser {
+public:
+    DraftTableParser(int year, PickHandler onPick);
+    ~DraftTableParser() override;
+
+    DraftTableParser(const DraftTableParser &) = delete;
+    DraftTableParser &operator=(const DraftTableParser &) = delete;
+
+    void feed(const char *data, size_t size) override;
+    void finish() override;
+
+    bool foundTable() const override { return tableDepth > 0 || tableDone; }
+    int getRowCount() const override { return rowCount; }
+
+private:
+    static void onStartElement(void *ctx, const xmlChar *name, const xmlChar **attrs);
+    static void onEndElement(void *ctx, const xmlChar *name);
+    static void onCharacters(void *ctx, const xmlChar *text, int length);
+
+    void endRow();
+
+    int year;
+    PickHandler onPick;
+    htmlParserCtxtPtr parser = nullptr;
+
+    int depth = 0;       // element depth in the document
+    int tableDepth = 0;  // depth of the picks table, 0 until it is found
+    int tbodyDepth = 0;
+    int rowDepth = 0;
+    int cellDepth = 0;
+    bool tableDone = false;
+    int rowCount = 0;
+
+    std::vector<std::string> rowData;
+    std::string cellText;
+};
+
+// Extractor for the article's wikitext (action=raw). Lines are split into table rows and cells with the
+// MediaWiki table syntax, and cell markup is reduced to the text the rendered page would show: link labels,
+// {{sortname}} names and footnote markers, without references, comments or other templates.
+class DraftWikitextParser : public DraftPageParser {
+public:
+    DraftWikitextParser(int year, PickHandler onPick);
+
+    void feed(const char *data, size_t size) override;
+    void finish() override;
+
+    bool foundTable() const override { return inTable || tableDone; }
+    int getRowCount() const override { return rowCount; }
+
+private:
+    void parseLine(std::string_view line);
+    void addCells(std::string_view line, std::string_view separator);
+    void endRow();
+
+    int year;
+    PickHandler onPick;
+    std::string pending; // incomplete last line of the previous chunk
+
+    bool inTable = false;
+    bool tableDone = false;
+    int nestedTables = 0;
+    int rowCount = 0;
+
+    std::vector<std::string> rowData; // raw cell markup, converted when the row ends
+};
+
+std::unique_ptr<DraftPageParser> makeDraftParser(int year, DraftSource source, DraftPageParser::PickHandler onPick);
+
+// Runs the streaming extractor over a page that is already in memory
+void parseDraftTable(int year, const std::string &page, const DraftPageParser::PickHandler &onPick,
+                     DraftSource source = DraftSource::Html);
+
+#endif // DRAFT_PARSER_H
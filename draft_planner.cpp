@@ -0,0 +1,70 @@
+#include "draft_planner.h"
+
+#include <algorithm>
+
+
+void DraftYearPlanner::addCandidate(size_t player, int yearsExp) {
+    int estimate = estimateDraftYear(currentYear, yearsExp);
+    Candidate candidate{estimate - earliestSlack, std::min(currentYear, estimate + latestSlack)};
+    if (candidate.firstYear > candidate.lastYear || !candidates.try_emplace(player, candidate).second) {
+        return;
+    }
+    for (int year = candidate.firstYear; year <= candidate.lastYear; ++year) {
+        demand[year]++;
+    }
+    unresolved++;
+}
+
+void DraftYearPlanner::resolve(size_t player, int year) {
+    auto it = candidates.find(player);
+    if (it == candidates.end() || it->second.resolved || year < it->second.firstYear || year > it->second.lastYear) {
+        return;
+    }
+    it->second.resolved = true;
+    for (int year = it->second.firstYear; year <= it->second.lastYear; ++year) {
+        demand[year]--;
+    }
+    unresolved--;
+}
+
+void DraftYearPlanner::markStored(int year) {
+    years[year] = true;
+}
+
+void DraftYearPlanner::markTried(int year) {
+    years.try_emplace(year, false);
+}
+
+std::vector<int> DraftYearPlanner::nextYears(size_t limit) const {
+    std::vector<std::pair<size_t, int>> open;
+    for (const auto &[year, count]: demand) {
+        if (count > 0 && !years.contains(year)) {
+            open.emplace_back(count, year);
+        }
+    }
+    std::ranges::sort(open, std::greater{});
+
+    std::vector<int> next;
+    for (size_t i = 0; i < open.size() && i < limit; ++i) {
+        next.push_back(open[i].second);
+    }
+    return next;
+}
+
+std::vector<size_t> DraftYearPlanner::exhausted() const {
+    std::vector<size_t> players;
+    for (const auto &[player, candidate]: candidates) {
+        if (candidate.resolved) {
+            continue;
+        }
+        bool allStored = true;
+        for (int year = candidate.firstYear; year <= candidate.lastYear && allStored; ++year) {
+            auto it = years.find(year);
+            allStored = it != years.end() && it->second;
+        }
+        if (allStored) {
+            players.push_back(player);
+        }
+    }
+    return players;
+}
@@ -0,0 +1,57 @@
+#ifndef DRAFT_PLANNER_H
+#define DRAFT_PLANNER_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+
+// Decides which draft years are worth fetching. Every player still without a pick is a candidate for the few
+// years years_exp allows; a year is only fetched while some candidate could still be found in it, and years are
+// handed out in order of how many candidates they could resolve. Once every candidate year of a player is stored
+// without a match, the player is taken to be undrafted.
+class DraftYearPlanner {
+public:
+    // Candidates may have been drafted from estimate - earliestSlack to estimate + latestSlack, where the estimate
+    // is currentYear - years_exp. Seasons missed to injury put the real year earlier; the offseason before
+    // years_exp ticks over puts it later.
+    static constexpr int earliestSlack = 2;
+    static constexpr int latestSlack = 1;
+
+    explicit DraftYearPlanner(int currentYear) : currentYear(currentYear) {}
+
+    static int estimateDraftYear(int currentYear, int yearsExp) { return currentYear - yearsExp; }
+
+    void addCandidate(size_t player, int yearsExp);
+    // A match in year only resolves the player when year is one they could have been drafted in; a namesake's pick
+    // from another class says nothing about the years still to fetch
+    void resolve(size_t player, int year);
+
+    // A stored year needs no fetch; a tried year is not handed out again this run even if its fetch failed
+    void markStored(int year);
+    void markTried(int year);
+
+    // Up to limit untried, unstored years with outstanding candidates, most candidates first and newest first on
+    // ties. Empty once nothing left can be resolved by fetching.
+    std::vector<int> nextYears(size_t limit) const;
+
+    // Unresolved candidates whose every plausible year is stored
+    std::vector<size_t> exhausted() const;
+
+    size_t outstanding() const { return unresolved; }
+
+private:
+    struct Candidate {
+        int firstYear;
+        int lastYear;
+        bool resolved = false;
+    };
+
+    int currentYear;
+    std::map<size_t, Candidate> candidates;
+    std::map<int, size_t> demand; // year -> unresolved candidates that could be in it
+    std::map<int, bool> years;    // year -> stored (true) or only tried (false)
+    size_t unresolved = 0;
+};
+
+#endif // DRAFT_PLANNER_H
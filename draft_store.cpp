@@ -0,0 +1,205 @@
+#include "draft_store.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "name_matching.h"
+
+
+void createDraftTables(SQLite::Database &db) {
+    db.exec("CREATE TABLE IF NOT EXISTS draft_picks ("
+            "year INTEGER, "
+            "round INTEGER, "
+            "pick INTEGER, "
+            "team TEXT, "
+            "raw_name TEXT, "
+            "normalized_name TEXT, "
+            "position TEXT, "
+            "PRIMARY KEY(year, round, pick))");
+
+    // Picks stored before positions were kept read back with an empty one
+    SQLite::Statement positionColumn(db, "SELECT 1 FROM pragma_table_info('draft_picks') WHERE name = 'position'");
+    if (!positionColumn.executeStep()) {
+        db.exec("ALTER TABLE draft_picks ADD COLUMN position TEXT");
+    }
+
+    db.exec("CREATE TABLE IF NOT EXISTS draft_years ("
+            "year INTEGER PRIMARY KEY, "
+            "complete INTEGER NOT NULL, "
+            "pick_count INTEGER, "
+            "fetched_at INTEGER, "
+            "revision INTEGER NOT NULL DEFAULT 1)");
+
+    SQLite::Statement revisionColumn(db, "SELECT 1 FROM pragma_table_info('draft_years') WHERE name = 'revision'");
+    if (!revisionColumn.executeStep()) {
+        db.exec("ALTER TABLE draft_years ADD COLUMN revision INTEGER NOT NULL DEFAULT 1");
+    }
+
+    db.exec("CREATE TABLE IF NOT EXISTS undrafted_players ("
+            "id TEXT PRIMARY KEY, "
+            "estimated_year INTEGER NOT NULL, "
+            "recorded_at INTEGER)");
+}
+
+std::vector<int> missingDraftYears(SQLite::Database &db, int startYear, int endYear) {
+    std::vector<int> complete;
+    SQLite::Statement query(db, "SELECT year FROM draft_years WHERE complete = 1 AND year BETWEEN ? AND ?");
+    query.bind(1, startYear);
+    query.bind(2, endYear);
+    while (query.executeStep()) {
+        complete.push_back(query.getColumn(0).getInt());
+    }
+
+    std::vector<int> missing;
+    for (int year = startYear; year <= endYear; ++year) {
+        if (std::ranges::find(complete, year) == complete.end()) {
+            missing.push_back(year);
+        }
+    }
+    return missing;
+}
+
+std::vector<int> recentIncompleteDraftYears(SQLite::Database &db, int startYear, int endYear) {
+    std::vector<int> years;
+    SQLite::Statement query(db, "SELECT year FROM draft_years WHERE complete = 0 AND year BETWEEN ? AND ? "
+                                "AND fetched_at > ?");
+    query.bind(1, startYear);
+    query.bind(2, endYear);
+    query.bind(3, (int64_t) time(nullptr) - std::chrono::seconds(draftRefetchInterval).count());
+    while (query.executeStep()) {
+        years.push_back(query.getColumn(0).getInt());
+    }
+    return years;
+}
+
+bool isDraftYearComplete(int year, const std::vector<DraftPick> &picks) {
+    time_t now = time(nullptr);
+    tm *ltm = localtime(&now);
+    int currentYear = 1900 + ltm->tm_year;
+
+    // An empty or cut-off table (a layout the parser does not know) is kept, but fetched again later
+    bool allRounds = std::ranges::any_of(picks, [](const DraftPick &pick) { return pick.round >= 7; });
+    if (year < currentYear) {
+        return allRounds;
+    }
+    return year == currentYear && allRounds && ltm->tm_mon >= 5;
+}
+
+// True when the stored picks of year are exactly picks, in the same order
+static bool sameStoredPicks(SQLite::Database &db, int year, const std::vector<DraftPick> &picks) {
+    SQLite::Statement query(db, "SELECT round, pick, team, raw_name, position FROM draft_picks "
+                                "WHERE year = ? ORDER BY rowid");
+    query.bind(1, year);
+    size_t i = 0;
+    while (query.executeStep()) {
+        if (i == picks.size() || picks[i].round != query.getColumn(0).getInt() ||
+            picks[i].pick != query.getColumn(1).getInt() || picks[i].team != query.getColumn(2).getText() ||
+            picks[i].player_name != query.getColumn(3).getText() || picks[i].position != query.getColumn(4).getText()) {
+            return false;
+        }
+        i++;
+    }
+    return i == picks.size();
+}
+
+void storeDraftYear(SQLite::Database &db, int year, const std::vector<DraftPick> &picks, bool complete) {
+    SQLite::Transaction transaction(db);
+
+    SQLite::Statement stored(db, "SELECT revision FROM draft_years WHERE year = ?");
+    stored.bind(1, year);
+    int64_t revision = 1;
+    bool same = false;
+    if (stored.executeStep()) {
+        revision = stored.getColumn(0).getInt64();
+        same = sameStoredPicks(db, year, picks);
+        revision += same ? 0 : 1;
+    }
+
+    if (!same) {
+        SQLite::Statement clear(db, "DELETE FROM draft_picks WHERE year = ?");
+        clear.bind(1, year);
+        clear.exec();
+
+        SQLite::Statement insert(db, "INSERT OR REPLACE INTO draft_picks "
+                                     "(year, round, pick, team, raw_name, normalized_name, position) "
+                                     "VALUES (?, ?, ?, ?, ?, ?, ?)");
+        for (const auto &pick: picks) {
+            insert.bind(1, pick.year);
+            insert.bind(2, pick.round);
+            insert.bind(3, pick.pick);
+            insert.bind(4, pick.team);
+            insert.bind(5, pick.player_name);
+            insert.bind(6, cleanName(pick.player_name));
+            insert.bind(7, pick.position);
+            insert.exec();
+            insert.reset();
+        }
+    }
+
+    SQLite::Statement mark(db, "INSERT OR REPLACE INTO draft_years (year, complete, pick_count, fetched_at, revision) "
+                               "VALUES (?, ?, ?, ?, ?)");
+    mark.bind(1, year);
+    mark.bind(2, complete ? 1 : 0);
+    mark.bind(3, (int) picks.size());
+    mark.bind(4, (int64_t) time(nullptr));
+    mark.bind(5, revision);
+    mark.exec();
+
+    transaction.commit();
+}
+
+void forEachStoredPick(SQLite::Database &db, int startYear, int endYear,
+                       const std::function<void(const DraftPick &pick)> &onPick) {
+    SQLite::Statement query(db, "SELECT year, round, pick, team, raw_name, position FROM draft_picks "
+                                "WHERE year BETWEEN ? AND ? "
+                                "ORDER BY year, rowid");
+    query.bind(1, startYear);
+    query.bind(2, endYear);
+
+    DraftPick pick;
+    while (query.executeStep()) {
+        pick.year = query.getColumn(0).getInt();
+        pick.round = query.getColumn(1).getInt();
+        pick.pick = query.getColumn(2).getInt();
+        pick.team = query.getColumn(3).getText();
+        pick.player_name = query.getColumn(4).getText();
+        pick.position = query.getColumn(5).getText();
+        onPick(pick);
+    }
+}
+
+std::unordered_map<std::string, int> loadUndraftedPlayers(SQLite::Database &db) {
+    std::unordered_map<std::string, int> undrafted;
+    SQLite::Statement query(db, "SELECT id, estimated_year FROM undrafted_players");
+    while (query.executeStep()) {
+        undrafted.emplace(query.getColumn(0).getText(), query.getColumn(1).getInt());
+    }
+    return undrafted;
+}
+
+void storeUndraftedPlayers(SQLite::Database &db, const std::vector<std::pair<std::string, int>> &undrafted,
+                           const std::vector<std::string> &drafted) {
+    if (undrafted.empty() && drafted.empty()) {
+        return;
+    }
+    SQLite::Transaction transaction(db);
+
+    SQLite::Statement insert(db, "INSERT OR REPLACE INTO undrafted_players (id, estimated_year, recorded_at) "
+                                 "VALUES (?, ?, ?)");
+    for (const auto &[id, estimatedYear]: undrafted) {
+        insert.bind(1, id);
+        insert.bind(2, estimatedYear);
+        insert.bind(3, (int64_t) time(nullptr));
+        insert.exec();
+        insert.reset();
+    }
+
+    SQLite::Statement remove(db, "DELETE FROM undrafted_players WHERE id = ?");
+    for (const auto &id: drafted) {
+        remove.bind(1, id);
+        remove.exec();
+        remove.reset();
+    }
+
+    transaction.commit();
+}
@@ -0,0 +1,49 @@
+#ifndef DRAFT_STORE_H
+#define DRAFT_STORE_H
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "draft_parser.h"
+
+
+// Parsed draft picks are kept in draft_picks, with one draft_years row per fetched year. Years marked complete
+// are never requested again; matching runs against the stored picks.
+void createDraftTables(SQLite::Database &db);
+
+// Years in [startYear, endYear] that have not been stored as complete yet
+std::vector<int> missingDraftYears(SQLite::Database &db, int startYear, int endYear);
+
+// A year stored as incomplete (the draft of the current year, until it is over) is not requested again until
+// this long after it was fetched. Its page is cached for as long.
+constexpr std::chrono::hours draftRefetchInterval{24};
+
+// Years in [startYear, endYear] stored as incomplete less than draftRefetchInterval ago
+std::vector<int> recentIncompleteDraftYears(SQLite::Database &db, int startYear, int endYear);
+
+// A year is complete once all seven rounds are listed, the current year only once the draft window (through May)
+// has passed as well, since the page fills in while the draft is running.
+bool isDraftYearComplete(int year, const std::vector<DraftPick> &picks);
+
+// Replaces the stored picks of one year in a single transaction. The year's revision goes up only when the picks
+// differ from the stored ones, so refetching an unchanged page does not count as a change.
+void storeDraftYear(SQLite::Database &db, int year, const std::vector<DraftPick> &picks, bool complete);
+
+// Stored picks in [startYear, endYear], oldest year first, in table order within a year
+void forEachStoredPick(SQLite::Database &db, int startYear, int endYear,
+                       const std::function<void(const DraftPick &pick)> &onPick);
+
+// Players found in none of the draft years they could have been drafted in, with the draft year their years_exp
+// pointed at when they were recorded. They are not planned for again while that estimate holds.
+std::unordered_map<std::string, int> loadUndraftedPlayers(SQLite::Database &db);
+
+// Records new undrafted players and forgets recorded ones that have since been matched to a pick
+void storeUndraftedPlayers(SQLite::Database &db, const std::vector<std::pair<std::string, int>> &undrafted,
+                           const std::vector<std::string> &drafted);
+
+#endif // DRAFT_STORE_H
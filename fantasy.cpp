@@ -0,0 +1,1113 @@
+#include "fantasy.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "draft_planner.h"
+#include "draft_store.h"
+#include "metrics.h"
+
+
+std::vector<std::string> playerColumns;
+PlayerStore players;
+NameIndex playerNameIndex;
+FuzzyNameMatcher playerFuzzyMatcher;
+
+json safeJsonParse(const std::string &jsonString, const std::string &errorContext) {
+    ScopedSpan span("json_parse", "parse");
+    if (metrics.isEnabled()) {
+        span.args = {{"what", errorContext}, {"bytes", jsonString.size()}};
+    }
+    try {
+        return json::parse(jsonString);
+    } catch (const json::parse_error &e) {
+        std::cerr << "JSON parse error in " << errorContext << ": " << e.what() << std::endl;
+        std::cerr << "Response: " << jsonString.substr(0, 100) << "..." << std::endl;
+        return json();
+    }
+}
+
+static bool tableHasColumn(SQLite::Database &db, const std::string &table, const std::string &column) {
+    SQLite::Statement query(db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?");
+    query.bind(1, table);
+    query.bind(2, column);
+    return query.executeStep();
+}
+
+// Tables written before league_id existed only ever held a single, unknown league. Their contents are refreshed
+// on every run anyway, so they are dropped and rebuilt with the league key rather than migrated.
+static void dropIfMissingLeagueId(SQLite::Database &db, const std::string &table) {
+    if (db.tableExists(table) && !tableHasColumn(db, table, "league_id")) {
+        db.exec("DROP TABLE " + table);
+    }
+}
+
+// WAL lets readers keep the last committed tables while a refresh writes, and with synchronous=NORMAL a commit
+// no longer waits for an fsync (only checkpoints do). The database stays consistent if the process dies.
+void configureDatabase(SQLite::Database &db) {
+    db.exec("PRAGMA journal_mode = WAL");
+    db.exec("PRAGMA synchronous = NORMAL");
+}
+
+void loadDatabase(SQLite::Database &db, const std::string &path) {
+    if (!std::filesystem::exists(path)) {
+        return;
+    }
+    ScopedSpan span("database_load", "sqlite");
+    // Opened writable so that closing it checkpoints any WAL into the file before persistDatabase() replaces it
+    SQLite::Database source(path, SQLite::OPEN_READWRITE);
+    SQLite::Backup backup(db, source);
+    backup.executeStep();
+    span.args = {{"pages", backup.getTotalPageCount()}};
+}
+
+bool persistDatabase(SQLite::Database &db, const std::string &path) {
+    ScopedSpan span("database_persist", "sqlite");
+    std::string tmp = path + ".tmp";
+    std::error_code ec;
+    try {
+        std::filesystem::remove(tmp);
+        {
+            SQLite::Database target(tmp, SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+            SQLite::Backup backup(target, db);
+            backup.executeStep();
+            if (backup.getRemainingPageCount() != 0) {
+                throw std::runtime_error("backup stopped with pages left");
+            }
+            span.args = {{"pages", backup.getTotalPageCount()}};
+        }
+        std::filesystem::rename(tmp, path);
+    } catch (std::exception &e) {
+        std::cerr << "Error while saving the database to " << path << ": " << e.what() << std::endl;
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+void createLeagueTables(SQLite::Database &db) {
+    dropIfMissingLeagueId(db, "teams");
+    dropIfMissingLeagueId(db, "rosters");
+
+    db.exec("CREATE TABLE IF NOT EXISTS teams ("
+            "league_id TEXT, "
+            "id TEXT, "
+            "name TEXT, "
+            "owner_id TEXT, "
+            "PRIMARY KEY(league_id, id))");
+
+    db.exec("CREATE TABLE IF NOT EXISTS rosters ("
+            "league_id TEXT, "
+            "team_id TEXT, "
+            "player_id TEXT, "
+            "FOREIGN KEY(league_id, team_id) REFERENCES teams(league_id, id), "
+            "FOREIGN KEY(player_id) REFERENCES players(id), "
+            "PRIMARY KEY(league_id, team_id, player_id))");
+
+    // Lets the players query probe a league's roster entry for each player
+    db.exec("CREATE INDEX IF NOT EXISTS rosters_by_player ON rosters(league_id, player_id, team_id)");
+}
+
+// The players dump and every league's users and rosters download together. Whichever finishes first is written
+// first, so league data is stored while the (much larger) players dump is still downloading. The dump is
+// fetched once however many leagues there are.
+SleeperChanges fetchSleeperData(SQLite::Database &db, ThreadPool &pool, HttpClient &http,
+                                const std::vector<std::string> &leagueIds, bool refreshPlayers, IngestMode mode) {
+    std::vector<std::string> urls;
+    for (const auto &league_id: leagueIds) {
+        urls.push_back("https://api.sleeper.app/v1/league/" + league_id + "/users");
+        urls.push_back("https://api.sleeper.app/v1/league/" + league_id + "/rosters");
+    }
+    size_t playersIndex = urls.size();
+    if (refreshPlayers) {
+        urls.emplace_back("https://api.sleeper.app/v1/players/nfl");
+    }
+
+    BoundedQueue<std::pair<size_t, HttpResponse>> responses(urls.size());
+    auto network = pool.submit([&] {
+        http.getAll(urls, [&responses](size_t index, HttpResponse &response) {
+            responses.push({index, std::move(response)});
+        });
+        responses.close();
+    });
+
+    SleeperChanges changes;
+    std::vector<std::string> users_responses(leagueIds.size());
+    std::vector<std::string> rosters_responses(leagueIds.size());
+    std::vector<int> leagueResponses(leagueIds.size());
+    while (auto item = responses.pop()) {
+        auto &[index, response] = *item;
+        if (!response.ok()) {
+            std::cerr << "HTTP request to " << response.url << " failed: " << response.error << std::endl;
+        }
+
+        if (index == playersIndex) {
+            if (response.body.empty()) {
+                std::cerr << "Failed to fetch players data. Exiting." << std::endl;
+                changes.playersFailed = true;
+            } else {
+                changes.playersFailed = !storePlayersResponse(db, response.body, changes.players, mode);
+            }
+            continue;
+        }
+
+        size_t league = index / 2;
+        (index % 2 == 0 ? users_responses : rosters_responses)[league] = std::move(response.body);
+        if (++leagueResponses[league] == 2) {
+            if (!storeLeagueData(db, leagueIds[league], users_responses[league], rosters_responses[league],
+                                 changes.rosters[leagueIds[league]])) {
+                changes.failedLeagues.push_back(leagueIds[league]);
+            }
+            users_responses[league].clear();
+            rosters_responses[league].clear();
+        }
+    }
+    network.get();
+    return changes;
+}
+
+bool storePlayersResponse(SQLite::Database &db, const std::string &players_response, PlayerChanges &changes,
+                          IngestMode mode) {
+    changes = {};
+    ScopedSpan span("players_ingest", "sqlite");
+    span.args = {{"bytes", players_response.size()}};
+    try {
+        SQLite::Transaction transaction(db);
+
+        std::vector<std::string> columns;
+        if (!ingestPlayersJson(db, players_response, columns, changes, mode)) {
+            std::cerr << "Failed to parse players data. Keeping the existing player database." << std::endl;
+            changes = {};
+            return false;
+        }
+
+        transaction.commit();
+        playerColumns = std::move(columns);
+
+        metrics.count("players.inserted", (int64_t) changes.inserted.size());
+        metrics.count("players.updated", (int64_t) changes.updated.size());
+        metrics.count("players.deleted", (int64_t) changes.deleted.size());
+        metrics.count("players.skipped_unchanged", (int64_t) changes.unchanged);
+
+        std::cout << "Players updated: " << changes.inserted.size() << " added, " << changes.updated.size()
+                  << " changed, " << changes.deleted.size() << " removed, " << changes.unchanged << " unchanged."
+                  << std::endl;
+
+    } catch (std::exception &e) {
+        std::cerr << "Error while updating players: " << e.what() << std::endl;
+        metrics.count("players.ingest_failures");
+        changes = {};
+        return false;
+    }
+    return true;
+}
+
+// Syncs the stored teams and rosters of one league with the latest responses. SQLite reads the JSON itself through
+// json_each(); the rosters are staged in a temp table and only the difference is written, so players dropped
+// since the last run disappear and the moves come back as RosterChanges.
+bool storeLeagueData(SQLite::Database &db, const std::string &league_id, const std::string &users_response,
+                     const std::string &rosters_response, RosterChanges &changes) {
+    changes = {};
+    if (users_response.empty()) {
+        std::cerr << "Failed to fetch users data. Exiting." << std::endl;
+        return false;
+    }
+    if (rosters_response.empty()) {
+        std::cerr << "Failed to fetch rosters data. Exiting." << std::endl;
+        return false;
+    }
+
+    ScopedSpan span("league_store", "sqlite");
+    SQLite::Transaction transaction(db);
+
+    try {
+        std::vector<std::string> renamedTeams;
+        SQLite::Statement renamed(db, "SELECT t.id FROM teams t "
+                                      "JOIN json_each(?2) u ON t.id = json_extract(u.value, '$.user_id') "
+                                      "WHERE t.league_id = ?1 "
+                                      "AND t.name IS NOT json_extract(u.value, '$.display_name')");
+        renamed.bind(1, league_id);
+        renamed.bind(2, users_response);
+        while (renamed.executeStep()) {
+            renamedTeams.emplace_back(renamed.getColumn(0).getText());
+        }
+
+        SQLite::Statement insert_teams(db, "INSERT OR REPLACE INTO teams (league_id, id, name, owner_id) "
+                                           "SELECT ?1, json_extract(u.value, '$.user_id'), "
+                                           "json_extract(u.value, '$.display_name'), json_extract(u.value, '$.user_id') "
+                                           "FROM json_each(?2) u");
+        insert_teams.bind(1, league_id);
+        insert_teams.bind(2, users_response);
+        int64_t teams = insert_teams.exec();
+
+        SQLite::Statement remove_teams(db, "DELETE FROM teams WHERE league_id = ?1 AND id NOT IN "
+                                           "(SELECT json_extract(u.value, '$.user_id') FROM json_each(?2) u)");
+        remove_teams.bind(1, league_id);
+        remove_teams.bind(2, users_response);
+        remove_teams.exec();
+
+        // A roster without players has "players": null, which json_each() reads as no rows
+        db.exec("CREATE TEMP TABLE IF NOT EXISTS roster_feed (team_id TEXT, player_id TEXT, "
+                "PRIMARY KEY(team_id, player_id))");
+        db.exec("DELETE FROM temp.roster_feed");
+        SQLite::Statement feed(db, "INSERT OR IGNORE INTO temp.roster_feed (team_id, player_id) "
+                                   "SELECT json_extract(r.value, '$.owner_id'), p.value "
+                                   "FROM json_each(?1) r, json_each(r.value, '$.players') p");
+        feed.bind(1, rosters_response);
+        int64_t roster_rows = feed.exec();
+
+        SQLite::Statement dropped(db, "SELECT team_id, player_id FROM rosters WHERE league_id = ?1 "
+                                      "EXCEPT SELECT team_id, player_id FROM temp.roster_feed");
+        dropped.bind(1, league_id);
+        while (dropped.executeStep()) {
+            changes.dropped.emplace_back(dropped.getColumn(0).getText(), dropped.getColumn(1).getText());
+        }
+        SQLite::Statement added(db, "SELECT team_id, player_id FROM temp.roster_feed "
+                                    "EXCEPT SELECT team_id, player_id FROM rosters WHERE league_id = ?1");
+        added.bind(1, league_id);
+        while (added.executeStep()) {
+            changes.added.emplace_back(added.getColumn(0).getText(), added.getColumn(1).getText());
+        }
+
+        SQLite::Statement remove(db, "DELETE FROM rosters WHERE league_id = ? AND team_id = ? AND player_id = ?");
+        for (const auto &[team, player]: changes.dropped) {
+            remove.bind(1, league_id);
+            remove.bind(2, team);
+            remove.bind(3, player);
+            remove.exec();
+            remove.reset();
+        }
+        SQLite::Statement insert(db, "INSERT INTO rosters (league_id, team_id, player_id) VALUES (?, ?, ?)");
+        for (const auto &[team, player]: changes.added) {
+            insert.bind(1, league_id);
+            insert.bind(2, team);
+            insert.bind(3, player);
+            insert.exec();
+            insert.reset();
+        }
+
+        // Their players' fantasy_team is out of date even though none of them moved
+        SQLite::Statement members(db, "SELECT player_id FROM rosters WHERE league_id = ? AND team_id = ?");
+        for (const auto &team: renamedTeams) {
+            members.bind(1, league_id);
+            members.bind(2, team);
+            while (members.executeStep()) {
+                changes.renamed.emplace_back(team, members.getColumn(0).getText());
+            }
+            members.reset();
+        }
+
+        transaction.commit();
+        metrics.count("league.teams", teams);
+        metrics.count("league.roster_rows", roster_rows);
+        metrics.count("league.roster_added", (int64_t) changes.added.size());
+        metrics.count("league.roster_dropped", (int64_t) changes.dropped.size());
+        metrics.count("league.teams_renamed", (int64_t) renamedTeams.size());
+
+    } catch (std::exception &e) {
+        std::cerr << "Error while updating league data: " << e.what() << std::endl;
+        changes = {};
+        return false;
+    }
+    return true;
+}
+
+int getCurrentYear() {
+    time_t now = time(nullptr);
+    tm *ltm = localtime(&now);
+    return 1900 + ltm->tm_year;
+}
+
+// Rostered and unrostered players of one league in a single pass: the filter is answered by the covering
+// players index and each row probes rosters_by_player, with unrostered players coming back with a NULL team.
+// The order only depends on the players table, so every league sees the same players in the same order.
+static SQLite::Statement leaguePlayersQuery(SQLite::Database &db, const std::string &league_id) {
+    bool hasStatus = std::ranges::find(playerColumns, "status") != playerColumns.end();
+    SQLite::Statement query(db, std::string("SELECT p.id, p.full_name, p.position, p.team, p.years_exp, t.name "
+                                            "FROM players p "
+                                            "LEFT JOIN rosters r ON r.league_id = ? AND r.player_id = p.id "
+                                            "LEFT JOIN teams t ON t.league_id = r.league_id AND t.id = r.team_id "
+                                            "WHERE p.position IN ('K', 'QB', 'RB', 'WR', 'TE') ") +
+                                        (hasStatus ? "AND p.status = 'Active' " : "") +
+                                        "AND p.team IS NOT NULL "
+                                        "ORDER BY p.position, p.team, p.id");
+    query.bind(1, league_id);
+    return query;
+}
+
+// Loads the players every league shares, with fantasy teams from the given league. Other leagues only need
+// assignFantasyTeams() afterwards.
+void storePlayersInMemory(SQLite::Database &db, const std::string &league_id) {
+    ScopedSpan span("load_players", "sqlite");
+    players.clear();
+
+    SQLite::Statement query = leaguePlayersQuery(db, league_id);
+    while (query.executeStep()) {
+        size_t i = players.add(query.getColumn(0).getText(), query.getColumn(1).getText(),
+                               query.getColumn(2).getText(), query.getColumn(3).getText(), query.getColumn(4).getInt());
+        players.setFantasyTeam(i, query.getColumn(5).isNull() ? "Unrostered" : query.getColumn(5).getText());
+    }
+
+    playerNameIndex.buildNormalized(players.normalizedNames());
+
+    std::vector<std::string> positions;
+    std::vector<int> yearsExp;
+    positions.reserve(players.size());
+    yearsExp.reserve(players.size());
+    for (size_t i = 0; i < players.size(); ++i) {
+        positions.push_back(players.position(i));
+        yearsExp.push_back(players.yearsExp(i));
+    }
+    playerFuzzyMatcher.build(players.normalizedNames(), positions, yearsExp, getCurrentYear());
+    metrics.count("players.loaded", (int64_t) players.size());
+}
+
+void assignFantasyTeams(SQLite::Database &db, const std::string &league_id) {
+    SQLite::Statement query = leaguePlayersQuery(db, league_id);
+    size_t i = 0;
+    while (query.executeStep() && i < players.size()) {
+        if (players.id(i) != query.getColumn(0).getText()) {
+            throw std::runtime_error("players table changed while assigning fantasy teams for league " + league_id);
+        }
+        players.setFantasyTeam(i++, query.getColumn(5).isNull() ? "Unrostered" : query.getColumn(5).getText());
+    }
+}
+
+std::pair<int, int> getDraftYearRange(const PlayerStore &players) {
+    int currentYear = getCurrentYear();
+    return std::make_pair(players.oldestDraftYear(currentYear) - DraftYearPlanner::earliestSlack, currentYear);
+}
+
+// Candidates are the players without a pick, less those recorded as undrafted under the same estimate; years
+// stored as complete never need fetching. An incomplete year fetched recently counts as tried: it is not fetched
+// again, and as it is not stored, nobody who could be in it is taken to be undrafted yet.
+static DraftYearPlanner planDraftYears(SQLite::Database &db, const std::unordered_map<std::string, int> &undrafted,
+                                       int startYear, int endYear) {
+    int currentYear = getCurrentYear();
+    DraftYearPlanner planner(currentYear);
+    for (size_t i = 0; i < players.size(); ++i) {
+        auto known = undrafted.find(players.id(i));
+        int estimate = DraftYearPlanner::estimateDraftYear(currentYear, players.yearsExp(i));
+        if (!players.isDrafted(i) && (known == undrafted.end() || known->second != estimate)) {
+            planner.addCandidate(i, players.yearsExp(i));
+        }
+    }
+
+    std::vector<int> missing = missingDraftYears(db, startYear, endYear);
+    for (int year = startYear; year <= endYear; ++year) {
+        if (std::ranges::find(missing, year) == missing.end()) {
+            planner.markStored(year);
+        }
+    }
+    for (int year: recentIncompleteDraftYears(db, startYear, endYear)) {
+        planner.markTried(year);
+    }
+    return planner;
+}
+
+bool draftYearsOutstanding(SQLite::Database &db) {
+    auto [startYear, endYear] = getDraftYearRange(players);
+    return !planDraftYears(db, loadUndraftedPlayers(db), startYear, endYear).nextYears(1).empty();
+}
+
+// Index of the picks section of each year's article, for the years whose lookup succeeded
+static std::map<int, int> findPicksSections(HttpClient &http, const std::vector<int> &years) {
+    std::vector<std::string> urls;
+    for (int year: years) {
+        urls.push_back(draftSectionsUrl(year));
+    }
+    std::map<int, int> sections;
+    http.getAll(urls, [&sections, &years](size_t index, HttpResponse &response) {
+        int section = response.ok() && response.status == 200 ? findPicksSection(response.body) : 0;
+        if (section > 0) {
+            sections[years[index]] = section;
+        }
+    });
+    metrics.count("draft.section_lookups", (int64_t) years.size());
+    metrics.count("draft.section_lookups_failed", (int64_t) (years.size() - sections.size()));
+    return sections;
+}
+
+// Matches the stored years first, then fetches the missing years the planner still has candidates for, one batch
+// of maxInFlight years at a time, until no fetch can resolve anyone. Within a batch the network stage streams
+// pages, the parse stage turns chunks into picks, this thread writes each finished year to draft_picks, and every
+// year is matched on the pool as soon as its picks are known. Matches only touch the global players vector in the
+// final, year-ordered merge. Wikitext is fetched one section at a time: the picks section is looked up first and
+// only it is requested. Years without one, or whose section has no picks table, fall back to the whole article's
+// wikitext and then to the rendered HTML.
+void loadDraftInformation(SQLite::Database &db, ThreadPool &pool, HttpClient &http, DraftSource source) {
+    players.clearDrafts();
+    auto [startYear, endYear] = getDraftYearRange(players);
+    std::unordered_map<std::string, int> undrafted = loadUndraftedPlayers(db);
+    DraftYearPlanner planner = planDraftYears(db, undrafted, startYear, endYear);
+
+    std::map<int, std::vector<DraftPick>> picksByYear;
+    forEachStoredPick(db, startYear, endYear,
+                      [&picksByYear](const DraftPick &pick) { picksByYear[pick.year].push_back(pick); });
+
+    std::map<int, std::future<std::vector<DraftMatch>>> pending;
+    std::map<int, std::vector<DraftMatch>> matches;
+    auto submitMatch = [&](int year) {
+        pending[year] = pool.submit([picks = std::move(picksByYear[year])] {
+            return matchDraftYear(playerNameIndex, playerFuzzyMatcher, players, picks);
+        });
+    };
+    // Waits for the submitted years; a player they matched within their own years stops being a candidate
+    auto collectMatches = [&] {
+        for (auto &[year, future]: pending) {
+            matches[year] = future.get();
+            for (const auto &match: matches[year]) {
+                planner.resolve(match.player, match.pick.year);
+            }
+        }
+        pending.clear();
+    };
+
+    for (const auto &[year, picks]: picksByYear) {
+        submitMatch(year);
+    }
+    collectMatches();
+    metrics.count("draft.candidates", (int64_t) planner.outstanding());
+
+    struct Chunk {
+        size_t index;
+        std::string data;
+        bool last;
+        HttpResponse response;
+    };
+    struct ParsedYear {
+        int year;
+        std::vector<DraftPick> picks;
+        HttpResponse response;
+        bool foundTable;
+    };
+    struct ParseTiming {
+        Metrics::Clock::time_point firstChunk;
+        Metrics::Clock::duration busy{};
+        size_t bytes = 0;
+    };
+
+    // Fetches and parses years from one source, by section where sections has one for the year, returning the
+    // wikitext years that should be fetched again another way
+    auto fetchYears = [&](const std::vector<int> &years, DraftSource pageSource, const std::map<int, int> &sections) {
+        std::vector<int> fallback;
+        if (years.empty()) {
+            return fallback;
+        }
+
+        BoundedQueue<Chunk> chunks(256);
+        BoundedQueue<ParsedYear> parsed(years.size());
+
+        std::vector<std::string> urls;
+        for (int year: years) {
+            auto section = sections.find(year);
+            urls.push_back(draftPageUrl(year, pageSource, section == sections.end() ? 0 : section->second));
+        }
+
+        auto network = pool.submit([&] {
+            http.getAll(
+                    urls,
+                    [&chunks](size_t index, HttpResponse &response) {
+                        chunks.push({index, {}, true, std::move(response)});
+                    },
+                    [&chunks](size_t index, const char *data, size_t size) {
+                        chunks.push({index, std::string(data, size), false, {}});
+                    });
+            chunks.close();
+        });
+
+        auto parser = pool.submit([&] {
+            std::vector<std::vector<DraftPick>> picks(years.size());
+            std::vector<std::unique_ptr<DraftPageParser>> parsers;
+            std::vector<ParseTiming> timings(years.size());
+            for (size_t i = 0; i < years.size(); ++i) {
+                parsers.push_back(makeDraftParser(years[i], pageSource,
+                                                  [&picks, i](const DraftPick &pick) { picks[i].push_back(pick); }));
+            }
+
+            while (auto chunk = chunks.pop()) {
+                ParseTiming &timing = timings[chunk->index];
+                auto started = Metrics::Clock::now();
+                if (timing.bytes == 0) {
+                    timing.firstChunk = started;
+                }
+                if (!chunk->last) {
+                    parsers[chunk->index]->feed(chunk->data.data(), chunk->data.size());
+                    timing.bytes += chunk->data.size();
+                    timing.busy += Metrics::Clock::now() - started;
+                    continue;
+                }
+                parsers[chunk->index]->finish();
+                bool foundTable = parsers[chunk->index]->foundTable();
+                parsers[chunk->index].reset();
+                timing.busy += Metrics::Clock::now() - started;
+
+                // The span covers the page arriving; busy_ms is the time actually spent parsing it
+                int year = years[chunk->index];
+                if (metrics.isEnabled()) {
+                    metrics.span(pageSource == DraftSource::Wikitext ? "wikitext_parse" : "html_parse", "parse",
+                                 timing.bytes > 0 ? timing.firstChunk : started, Metrics::Clock::now(),
+                                 {{"year", year},
+                                  {"bytes", timing.bytes},
+                                  {"busy_ms", std::chrono::duration<double, std::milli>(timing.busy).count()},
+                                  {"picks", picks[chunk->index].size()}});
+                    metrics.count("draft." + std::to_string(year) + ".picks_parsed",
+                                  (int64_t) picks[chunk->index].size());
+                    metrics.count("draft.picks_parsed", (int64_t) picks[chunk->index].size());
+                }
+                parsed.push({year, std::move(picks[chunk->index]), std::move(chunk->response), foundTable});
+            }
+            parsed.close();
+        });
+
+        while (auto year = parsed.pop()) {
+            if (pageSource == DraftSource::Wikitext &&
+                (!year->response.ok() || year->response.status != 200 || !year->foundTable || year->picks.empty())) {
+                metrics.count("draft.wikitext_fallbacks");
+                fallback.push_back(year->year);
+                continue;
+            }
+            if (!year->response.ok()) {
+                std::cerr << "HTTP request to " << year->response.url << " failed: " << year->response.error
+                          << std::endl;
+                continue;
+            }
+            // A 429 or 5xx left after the retries has no error of its own; storing it would hold off the next
+            // fetch of the year for the refetch interval
+            if (year->response.status != 200) {
+                std::cerr << "HTTP request to " << year->response.url << " failed with status "
+                          << year->response.status << std::endl;
+                metrics.count("draft.fetch_failures");
+                continue;
+            }
+
+            bool complete = isDraftYearComplete(year->year, year->picks);
+            try {
+                ScopedSpan span("draft_store", "sqlite");
+                if (metrics.isEnabled()) {
+                    span.args = {{"year", year->year}, {"rows", year->picks.size()}};
+                }
+                storeDraftYear(db, year->year, year->picks, complete);
+                if (complete) {
+                    planner.markStored(year->year);
+                }
+            } catch (std::exception &e) {
+                std::cerr << "Error while storing draft picks for " << year->year << ": " << e.what() << std::endl;
+            }
+            picksByYear[year->year] = std::move(year->picks);
+            submitMatch(year->year);
+        }
+
+        network.get();
+        parser.get();
+        std::ranges::sort(fallback);
+        return fallback;
+    };
+
+    for (std::vector<int> years; !(years = planner.nextYears(http.getMaxInFlight())).empty();) {
+        std::cout << "Fetching draft information for";
+        for (int year: years) {
+            std::cout << " " << year;
+            planner.markTried(year);
+        }
+        std::cout << " (" << planner.outstanding() << " players unmatched)" << std::endl;
+
+        std::vector<int> fallback;
+        if (source == DraftSource::Wikitext) {
+            // Only the picks section is fetched where it can be found; the others, and sections without the
+            // picks, are fetched as the whole article
+            std::map<int, int> sections = findPicksSections(http, years);
+            std::vector<int> bySection;
+            for (int year: years) {
+                (sections.contains(year) ? bySection : fallback).push_back(year);
+            }
+            std::vector<int> whole = fetchYears(bySection, source, sections);
+            whole.insert(whole.end(), fallback.begin(), fallback.end());
+            std::ranges::sort(whole);
+            fallback = fetchYears(whole, source, {});
+        } else {
+            fetchYears(years, source, {});
+        }
+        fetchYears(fallback, DraftSource::Html, {});
+        collectMatches();
+        metrics.count("draft.years_fetched", (int64_t) years.size());
+    }
+
+    // Oldest year first, so a later draft overwrites an earlier match. Fuzzy matches go in first so that an exact
+    // match from any year takes precedence over them.
+    std::vector<DraftMatch> exactMatches;
+    for (auto &[year, match]: matches) {
+        for (auto &draftMatch: match) {
+            if (draftMatch.fuzzy) {
+                applyDraftMatch(draftMatch);
+            } else {
+                exactMatches.push_back(std::move(draftMatch));
+            }
+        }
+    }
+    for (const auto &draftMatch: exactMatches) {
+        applyDraftMatch(draftMatch);
+    }
+
+    // A player whose only matches are outside their years is drafted all the same
+    std::vector<std::pair<std::string, int>> newlyUndrafted;
+    for (size_t player: planner.exhausted()) {
+        if (players.isDrafted(player)) {
+            continue;
+        }
+        newlyUndrafted.emplace_back(players.id(player),
+                                    DraftYearPlanner::estimateDraftYear(endYear, players.yearsExp(player)));
+    }
+    std::vector<std::string> nowDrafted;
+    for (size_t i = 0; i < players.size(); ++i) {
+        if (players.isDrafted(i) && undrafted.contains(players.id(i))) {
+            nowDrafted.push_back(players.id(i));
+        }
+    }
+    try {
+        storeUndraftedPlayers(db, newlyUndrafted, nowDrafted);
+    } catch (std::exception &e) {
+        std::cerr << "Error while recording undrafted players: " << e.what() << std::endl;
+    }
+    metrics.count("draft.undrafted_recorded", (int64_t) newlyUndrafted.size());
+}
+
+std::vector<DraftMatch> matchDraftYear(const NameIndex &index, const FuzzyNameMatcher &fuzzy,
+                                       const PlayerStore &candidates, const std::vector<DraftPick> &picks) {
+    ScopedSpan span("match", "match");
+    std::vector<DraftMatch> matches;
+    std::vector<const DraftPick *> leftover;
+    std::vector<bool> taken(index.size(), false);
+    for (const auto &pick: picks) {
+        int player = index.findFirst(pick.player_name);
+        if (player >= 0) {
+            matches.push_back({(size_t) player, pick});
+            taken[(size_t) player] = true;
+        } else {
+            leftover.push_back(&pick);
+        }
+    }
+
+    size_t fuzzyMatched = 0;
+    json ambiguous = json::array();
+    for (const DraftPick *pick: leftover) {
+        FuzzyMatch match = fuzzy.find(pick->player_name, pick->position, pick->year, taken);
+        if (match.accepted) {
+            matches.push_back({(size_t) match.index, *pick, true});
+            taken[(size_t) match.index] = true;
+            fuzzyMatched++;
+        } else if (match.ambiguous && metrics.isEnabled()) {
+            ambiguous.push_back({{"pick", pick->player_name},
+                                 {"round", pick->round},
+                                 {"candidates", {candidates.fullName((size_t) match.index),
+                                                 candidates.fullName((size_t) match.runnerUp)}}});
+        }
+    }
+
+    if (metrics.isEnabled() && !picks.empty()) {
+        std::string year = std::to_string(picks.front().year);
+        auto unmatched = (int64_t) (picks.size() - matches.size());
+        span.args = {{"year", picks.front().year},
+                     {"matched", matches.size()},
+                     {"fuzzy", fuzzyMatched},
+                     {"unmatched", unmatched}};
+        if (!ambiguous.empty()) {
+            span.args["ambiguous"] = ambiguous;
+        }
+        metrics.count("draft." + year + ".picks_matched", (int64_t) matches.size());
+        metrics.count("draft." + year + ".picks_unmatched", unmatched);
+        metrics.count("draft.picks_matched", (int64_t) matches.size());
+        metrics.count("draft.picks_fuzzy_matched", (int64_t) fuzzyMatched);
+        metrics.count("draft.picks_ambiguous", (int64_t) ambiguous.size());
+        metrics.count("draft.picks_unmatched", unmatched);
+    }
+    return matches;
+}
+
+void applyDraftMatch(const DraftMatch &match) {
+    players.setDraft(match.player, match.pick);
+}
+
+
+void createProcessedPlayersTable(SQLite::Database &db) {
+    dropIfMissingLeagueId(db, "processed_players");
+
+    db.exec("CREATE TABLE IF NOT EXISTS processed_players ("
+            "league_id TEXT, "
+            "id TEXT, "
+            "full_name TEXT, "
+            "position TEXT, "
+            "nfl_team TEXT, "
+            "fantasy_team TEXT, "
+            "years_exp INTEGER, "
+            "draft_year INTEGER, "
+            "draft_round INTEGER, "
+            "draft_pick INTEGER, "
+            "draft_team TEXT, "
+            "PRIMARY KEY(league_id, id))");
+
+    db.exec("CREATE TABLE IF NOT EXISTS processed_leagues ("
+            "league_id TEXT PRIMARY KEY, "
+            "inputs TEXT, "
+            "stored_at INTEGER)");
+}
+
+// Bumped whenever matching changes, so rows matched by an older build are not restored
+static constexpr const char *draftMatchVersion = "match-2";
+
+// Both counters only ever go up: the players generation with every sync that changed a player, the sum of the
+// draft year revisions with every year added or changed. Equal fingerprints therefore mean equal inputs.
+std::string draftInputsFingerprint(SQLite::Database &db, bool beforePlayersSync) {
+    try {
+        int64_t generation = playersGeneration(db) - (beforePlayersSync ? 1 : 0);
+        return std::string(draftMatchVersion) + "/" + std::to_string(generation) + "/" +
+               db.execAndGet("SELECT count(*) || ':' || ifnull(sum(revision), 0) FROM draft_years").getString();
+    } catch (std::exception &e) {
+        std::cerr << "Error while reading the draft inputs: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+bool processedPlayersCurrent(SQLite::Database &db, const std::string &league_id, const std::string &inputs) {
+    if (inputs.empty()) {
+        return false;
+    }
+    SQLite::Statement query(db, "SELECT 1 FROM processed_leagues WHERE league_id = ? AND inputs = ?");
+    query.bind(1, league_id);
+    query.bind(2, inputs);
+    return query.executeStep();
+}
+
+static std::unordered_map<std::string_view, size_t> playersById() {
+    std::unordered_map<std::string_view, size_t> rows;
+    rows.reserve(players.size());
+    for (size_t i = 0; i < players.size(); ++i) {
+        rows.emplace(players.id(i), i);
+    }
+    return rows;
+}
+
+void restoreDraftInformation(SQLite::Database &db, const std::string &league_id) {
+    ScopedSpan span("draft_restore", "sqlite");
+    auto rows = playersById();
+    SQLite::Statement query(db, "SELECT id, draft_year, draft_round, draft_pick, draft_team FROM processed_players "
+                                "WHERE league_id = ?");
+    query.bind(1, league_id);
+
+    DraftPick pick;
+    size_t restored = 0;
+    while (query.executeStep()) {
+        auto row = rows.find(query.getColumn(0).getText());
+        if (row == rows.end()) {
+            continue;
+        }
+        pick.year = query.getColumn(1).getInt();
+        pick.round = query.getColumn(2).getInt();
+        pick.pick = query.getColumn(3).getInt();
+        pick.team = query.getColumn(4).getText();
+        players.setDraft(row->second, pick);
+        restored++;
+    }
+    span.args = {{"players", restored}};
+    metrics.count("draft.restored", (int64_t) restored);
+}
+
+bool rematchPlayers(SQLite::Database &db, const std::vector<std::string> &ids) {
+    ScopedSpan span("draft_rematch", "match");
+    auto rows = playersById();
+
+    // The players to match as a store of their own; changedRows maps its rows back to players, previous holds the
+    // pick each had before (year 0 for none)
+    using PickKey = std::tuple<int, int, int>;
+    PlayerStore changed;
+    std::vector<size_t> changedRows;
+    std::vector<PickKey> previous;
+    std::vector<std::string> positions;
+    std::vector<int> yearsExp;
+    for (const auto &id: ids) {
+        auto row = rows.find(id);
+        if (row == rows.end()) {
+            continue;
+        }
+        size_t i = row->second;
+        previous.emplace_back(players.draftYear(i), players.draftRound(i), players.draftPick(i));
+        players.clearDraft(i);
+        changed.add(players.id(i), players.fullName(i), players.position(i), players.nflTeam(i), players.yearsExp(i));
+        changedRows.push_back(i);
+        positions.push_back(players.position(i));
+        yearsExp.push_back(players.yearsExp(i));
+    }
+    span.args = {{"players", changedRows.size()}};
+    if (changedRows.empty()) {
+        return true;
+    }
+
+    std::set<PickKey> held;
+    for (size_t i = 0; i < players.size(); ++i) {
+        if (players.isDrafted(i)) {
+            held.emplace(players.draftYear(i), players.draftRound(i), players.draftPick(i));
+        }
+    }
+    auto [startYear, endYear] = getDraftYearRange(players);
+    std::map<int, std::vector<DraftPick>> picksByYear;
+    forEachStoredPick(db, startYear, endYear,
+                      [&picksByYear](const DraftPick &pick) { picksByYear[pick.year].push_back(pick); });
+
+    NameIndex index;
+    index.buildNormalized(changed.normalizedNames());
+    FuzzyNameMatcher fuzzy;
+    fuzzy.build(changed.normalizedNames(), positions, yearsExp, getCurrentYear());
+
+    // A pick another player holds is contested: who wins it depends on the order and kind of both matches, which
+    // only a full pass works out
+    std::vector<DraftMatch> matches;
+    for (const auto &[year, picks]: picksByYear) {
+        for (auto &match: matchDraftYear(index, fuzzy, changed, picks)) {
+            if (held.contains({match.pick.year, match.pick.round, match.pick.pick})) {
+                span.args["contested"] = true;
+                return false;
+            }
+            match.player = changedRows[match.player];
+            matches.push_back(std::move(match));
+        }
+    }
+
+    // Merged like loadDraftInformation(): oldest year first, fuzzy matches before exact ones
+    for (const auto &match: matches) {
+        if (match.fuzzy) {
+            applyDraftMatch(match);
+        }
+    }
+    for (const auto &match: matches) {
+        if (!match.fuzzy) {
+            applyDraftMatch(match);
+        }
+    }
+
+    // A player who lost their pick frees it for players who did not change, which only a full pass offers it to
+    for (size_t j = 0; j < changedRows.size(); ++j) {
+        size_t i = changedRows[j];
+        if (std::get<0>(previous[j]) != 0 &&
+            previous[j] != PickKey{players.draftYear(i), players.draftRound(i), players.draftPick(i)}) {
+            span.args["released"] = true;
+            return false;
+        }
+    }
+
+    std::unordered_map<std::string, int> undrafted = loadUndraftedPlayers(db);
+    std::vector<std::string> nowDrafted;
+    size_t matched = 0;
+    for (size_t i: changedRows) {
+        matched += players.isDrafted(i);
+        if (players.isDrafted(i) && undrafted.contains(players.id(i))) {
+            nowDrafted.push_back(players.id(i));
+        }
+    }
+    try {
+        storeUndraftedPlayers(db, {}, nowDrafted);
+    } catch (std::exception &e) {
+        std::cerr << "Error while recording undrafted players: " << e.what() << std::endl;
+    }
+    span.args["matched"] = matched;
+    metrics.count("draft.rematched", (int64_t) changedRows.size());
+    return true;
+}
+
+// One processed_players row without its keys
+struct ProcessedRow {
+    std::string fullName;
+    std::string position;
+    std::string nflTeam;
+    std::string fantasyTeam;
+    int yearsExp;
+    int draftYear;
+    int draftRound;
+    int draftPick;
+    std::string draftTeam;
+
+    bool operator==(const ProcessedRow &) const = default;
+};
+
+static ProcessedRow processedRow(size_t i) {
+    return {players.fullName(i), players.position(i), players.nflTeam(i), players.fantasyTeam(i), players.yearsExp(i),
+            players.draftYear(i), players.draftRound(i), players.draftPick(i), players.draftTeam(i)};
+}
+
+bool storeProcessedPlayers(SQLite::Database &db, const std::string &league_id, const std::string &inputs,
+                           const std::vector<std::string> *playerIds) {
+    ScopedSpan span("processed_players_store", "sqlite");
+    SQLite::Transaction transaction(db);
+
+    try {
+        // The stored rows of the players being compared
+        std::unordered_map<std::string, ProcessedRow> stored;
+        SQLite::Statement select(db, std::string("SELECT id, full_name, position, nfl_team, fantasy_team, years_exp, "
+                                                 "draft_year, draft_round, draft_pick, draft_team "
+                                                 "FROM processed_players WHERE league_id = ?") +
+                                             (playerIds ? " AND id = ?" : ""));
+        auto readStored = [&] {
+            while (select.executeStep()) {
+                stored.emplace(select.getColumn(0).getText(),
+                               ProcessedRow{select.getColumn(1).getText(), select.getColumn(2).getText(),
+                                            select.getColumn(3).getText(), select.getColumn(4).getText(),
+                                            select.getColumn(5).getInt(), select.getColumn(6).getInt(),
+                                            select.getColumn(7).getInt(), select.getColumn(8).getInt(),
+                                            select.getColumn(9).getText()});
+            }
+            select.reset();
+        };
+        select.bind(1, league_id);
+        if (playerIds) {
+            for (const auto &id: *playerIds) {
+                select.bind(2, id);
+                readStored();
+            }
+        } else {
+            readStored();
+        }
+
+        SQLite::Statement upsert(db, "INSERT OR REPLACE INTO processed_players "
+                                     "(league_id, id, full_name, position, nfl_team, fantasy_team, years_exp, "
+                                     "draft_year, draft_round, draft_pick, draft_team) "
+                                     "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        SQLite::Statement remove(db, "DELETE FROM processed_players WHERE league_id = ? AND id = ?");
+        int64_t written = 0;
+        int64_t removed = 0;
+        auto removeRow = [&](const std::string &id) {
+            remove.bind(1, league_id);
+            remove.bind(2, id);
+            remove.exec();
+            remove.reset();
+            removed++;
+        };
+
+        auto sync = [&](size_t i) {
+            auto existing = stored.find(players.id(i));
+            if (!players.isDrafted(i)) {
+                if (existing != stored.end()) {
+                    removeRow(existing->first);
+                    stored.erase(existing);
+                }
+                return;
+            }
+            ProcessedRow row = processedRow(i);
+            if (existing != stored.end()) {
+                bool same = existing->second == row;
+                stored.erase(existing);
+                if (same) {
+                    return;
+                }
+            }
+            upsert.bind(1, league_id);
+            upsert.bind(2, players.id(i));
+            upsert.bind(3, row.fullName);
+            upsert.bind(4, row.position);
+            upsert.bind(5, row.nflTeam);
+            upsert.bind(6, row.fantasyTeam);
+            upsert.bind(7, row.yearsExp);
+            upsert.bind(8, row.draftYear);
+            upsert.bind(9, row.draftRound);
+            upsert.bind(10, row.draftPick);
+            upsert.bind(11, row.draftTeam);
+            upsert.exec();
+            upsert.reset();
+            written++;
+        };
+
+        int stored_count = 0;
+        if (playerIds) {
+            std::unordered_set<std::string_view> wanted(playerIds->begin(), playerIds->end());
+            for (size_t i = 0; i < players.size(); ++i) {
+                stored_count += players.isDrafted(i);
+                if (wanted.contains(players.id(i))) {
+                    sync(i);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < players.size(); ++i) {
+                stored_count += players.isDrafted(i);
+                sync(i);
+            }
+        }
+        // Rows left over belong to players no longer in the working set
+        for (const auto &[id, row]: stored) {
+            removeRow(id);
+        }
+
+        SQLite::Statement mark(db, "INSERT OR REPLACE INTO processed_leagues (league_id, inputs, stored_at) "
+                                   "VALUES (?, ?, ?)");
+        mark.bind(1, league_id);
+        mark.bind(2, inputs);
+        mark.bind(3, (int64_t) time(nullptr));
+        mark.exec();
+
+        transaction.commit();
+        span.args = {{"league", league_id}, {"written", written}, {"removed", removed}, {"partial", playerIds != nullptr}};
+        metrics.count("processed_players.stored", stored_count);
+        metrics.count("processed_players.written", written);
+        metrics.count("processed_players.removed", removed);
+        std::cout << "Successfully stored " << stored_count << " drafted players for league " << league_id << " ("
+                  << written << " written, " << removed << " removed)." << std::endl;
+    } catch (std::exception &e) {
+        std::cerr << "Error while storing processed players: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Shared by the live and the snapshot report: Source is a PlayerStore or a Snapshot, fantasyTeam(i) the team
+// player i is rostered on in the league being shown
+template<typename Source, typename FantasyTeam>
+static void printHighDraftPlayers(const Source &source, FantasyTeam fantasyTeam) {
+    int currentYear = getCurrentYear();
+    int threeYearsAgo = currentYear - 2; // To get the last 3 years
+
+    std::cout << "\n========== High Draft Picks (Last 3 Drafts) ==========\n";
+
+    int prevYear = 0;
+    for (size_t i: source.draftedSince(threeYearsAgo, 3)) {
+        int year = source.draftYear(i);
+        if (year != prevYear) {
+            if (prevYear != 0)
+                std::cout << std::string(100, '-') << "\n";
+            std::cout << "\nDraft Year: " << year << "\n";
+            std::cout << std::string(100, '-') << "\n";
+            std::cout << std::left << std::setw(30) << "Player" << std::setw(5) << "Pos" << std::setw(15)
+                      << "NFL Team" << std::setw(10) << "Round" << std::setw(5) << "Pick" << std::setw(25) << "Fantasy Team" << "\n";
+            std::cout << std::string(100, '-') << "\n";
+            prevYear = year;
+        }
+
+        std::string team(fantasyTeam(i));
+        if (team == "Unrostered") {
+            team = "UNROSTERED";
+        }
+
+        std::cout << std::left << std::setw(30) << source.fullName(i)
+                  << std::setw(5) << source.position(i)
+                  << std::setw(15) << source.nflTeam(i)
+                  << std::setw(10) << source.draftRound(i)
+                  << std::setw(5) << source.draftPick(i)
+                  << std::setw(25) << team << "\n";
+    }
+    std::cout << std::string(100, '=') << "\n";
+}
+
+void displayRecentHighDraftPlayers(const PlayerStore &players) {
+    printHighDraftPlayers(players, [&players](size_t i) { return players.fantasyTeam(i); });
+}
+
+void displayRecentHighDraftPlayers(const Snapshot &snapshot, size_t league) {
+    printHighDraftPlayers(snapshot, [&snapshot, league](size_t i) { return snapshot.fantasyTeam(league, i); });
+}
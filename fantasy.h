@@ -0,0 +1,113 @@
+#ifndef FANTASY_H
+#define FANTASY_H
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "draft_parser.h"
+#include "http_client.h"
+#include "name_matching.h"
+#include "pipeline.h"
+#include "player_store.h"
+#include "players_ingest.h"
+#include "snapshot.h"
+
+
+using json = nlohmann::json;
+
+// A stored pick matched to a row of players, produced by the matching stage and merged afterwards
+struct DraftMatch {
+    size_t player;
+    DraftPick pick;
+    bool fuzzy = false; // found by FuzzyNameMatcher rather than the NameIndex
+};
+
+// Roster moves of one league since the previous sync, as (team id, player id). A player who changed teams is
+// dropped from the old team and added to the new one. renamed lists the players on teams whose name changed.
+struct RosterChanges {
+    std::vector<std::pair<std::string, std::string>> added;
+    std::vector<std::pair<std::string, std::string>> dropped;
+    std::vector<std::pair<std::string, std::string>> renamed;
+
+    bool empty() const { return added.empty() && dropped.empty() && renamed.empty(); }
+};
+
+// What one Sleeper sync changed: the players delta (empty unless the dump was refreshed) and the roster moves of
+// each league, along with what could not be fetched or stored
+struct SleeperChanges {
+    PlayerChanges players;
+    std::map<std::string, RosterChanges> rosters;
+    bool playersFailed = false;
+    std::vector<std::string> failedLeagues;
+};
+
+// Columns of the players table, the in-memory players of the current run and the name indexes over them
+extern std::vector<std::string> playerColumns;
+extern PlayerStore players;
+extern NameIndex playerNameIndex;
+extern FuzzyNameMatcher playerFuzzyMatcher;
+
+json safeJsonParse(const std::string &jsonString, const std::string &errorContext);
+
+void configureDatabase(SQLite::Database &db);
+// Copies the database file at path, when there is one, into db (an in-memory database) with the online backup API
+void loadDatabase(SQLite::Database &db, const std::string &path);
+// Replaces the file at path with a copy of db: the backup goes to a temporary file that is renamed over path, so
+// the file always holds the result of one whole run
+bool persistDatabase(SQLite::Database &db, const std::string &path);
+void createLeagueTables(SQLite::Database &db);
+SleeperChanges fetchSleeperData(SQLite::Database &db, ThreadPool &pool, HttpClient &http,
+                                const std::vector<std::string> &leagueIds, bool refreshPlayers,
+                                IngestMode mode = IngestMode::Incremental);
+// Both return false, with changes left empty, when the response could not be stored
+bool storePlayersResponse(SQLite::Database &db, const std::string &players_response, PlayerChanges &changes,
+                          IngestMode mode = IngestMode::Incremental);
+bool storeLeagueData(SQLite::Database &db, const std::string &league_id, const std::string &users_response,
+                     const std::string &rosters_response, RosterChanges &changes);
+void storePlayersInMemory(SQLite::Database &db, const std::string &league_id);
+void assignFantasyTeams(SQLite::Database &db, const std::string &league_id);
+// Every year a loaded player could have been drafted in, from the oldest years_exp estimate through this year
+std::pair<int, int> getDraftYearRange(const PlayerStore &players);
+// True when some player without a pick could still be found in a draft year that is not stored yet
+bool draftYearsOutstanding(SQLite::Database &db);
+// Matches every player against the stored picks and fetches only the missing years that can still resolve
+// someone; players left unmatched in all of their plausible years are recorded as undrafted
+void loadDraftInformation(SQLite::Database &db, ThreadPool &pool, HttpClient &http,
+                          DraftSource source = DraftSource::Wikitext);
+// Matches picks through the index first; the picks it leaves over go to the fuzzy matcher, which can take each
+// player at most once and skips players an exact match already took. candidates is the store both were built
+// from; it is only read, for the names reported with ambiguous picks.
+std::vector<DraftMatch> matchDraftYear(const NameIndex &index, const FuzzyNameMatcher &fuzzy,
+                                       const PlayerStore &candidates, const std::vector<DraftPick> &picks);
+void applyDraftMatch(const DraftMatch &match);
+void createProcessedPlayersTable(SQLite::Database &db);
+
+// Identifies what the draft columns of processed_players are derived from: the players generation, the revisions
+// of the stored draft years and the matching rules. Empty when it cannot be worked out, which never equals a
+// stored value. With beforePlayersSync, the fingerprint as it was before the last sync that changed a player.
+std::string draftInputsFingerprint(SQLite::Database &db, bool beforePlayersSync = false);
+// True when the processed_players rows of league_id were written from the given inputs
+bool processedPlayersCurrent(SQLite::Database &db, const std::string &league_id, const std::string &inputs);
+// Copies the draft columns stored for league_id onto the in-memory players instead of matching picks again. Only
+// valid when processedPlayersCurrent() holds for the league.
+void restoreDraftInformation(SQLite::Database &db, const std::string &league_id);
+// After restoreDraftInformation(), matches the given players again, on their own, against the stored picks. Used
+// for the players a sync changed, so the rest keep their restored picks. Returns false, leaving the draft columns
+// to a full loadDraftInformation(), when the result could differ from a full pass: one of them matched a pick
+// another player holds, or one lost the pick they held.
+bool rematchPlayers(SQLite::Database &db, const std::vector<std::string> &ids);
+// Brings the processed_players rows of one league in line with the in-memory players, writing only rows that
+// differ. With playerIds only those players are compared, for runs where nobody else can have changed. Returns
+// false if the rows could not be written.
+bool storeProcessedPlayers(SQLite::Database &db, const std::string &league_id, const std::string &inputs = "",
+                           const std::vector<std::string> *playerIds = nullptr);
+void displayRecentHighDraftPlayers(const PlayerStore &players);
+// The same report for one league of a snapshot, without touching the database
+void displayRecentHighDraftPlayers(const Snapshot &snapshot, size_t league);
+int getCurrentYear();
+
+#endif // FANTASY_H
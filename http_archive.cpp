@@ -0,0 +1,163 @@
+#include "http_archive.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static constexpr char archiveMagic[8] = {'F', 'N', 'T', 'H', 'T', 'T', 'P', '\0'};
+static constexpr uint32_t archiveByteOrder = 0x01020304;
+
+static_assert(sizeof(HttpArchiveHeader) == 16);
+static_assert(sizeof(HttpArchiveRecord) == 24);
+
+static uint64_t padded(uint64_t size) {
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+HttpArchiveWriter::~HttpArchiveWriter() {
+    discard();
+}
+
+bool HttpArchiveWriter::open(const std::filesystem::path &archivePath) {
+    discard();
+    path = archivePath;
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    out.open(tmp, std::ios::binary | std::ios::trunc);
+
+    HttpArchiveHeader header{};
+    std::memcpy(header.magic, archiveMagic, sizeof(header.magic));
+    header.version = httpArchiveVersion;
+    header.byteOrder = archiveByteOrder;
+    if (!out.write((const char *) &header, sizeof(header))) {
+        std::cerr << "Cannot write HTTP archive " << tmp << std::endl;
+        out.close();
+        return false;
+    }
+    records = 0;
+    return true;
+}
+
+void HttpArchiveWriter::add(std::string_view url, long status, std::string_view headers, std::string_view body) {
+    if (!out.is_open()) {
+        return;
+    }
+    static constexpr char zeros[8] = {};
+    HttpArchiveRecord record{(uint32_t) url.size(), (uint32_t) headers.size(), body.size(), (int32_t) status, 0};
+    uint64_t size = url.size() + headers.size() + body.size();
+    out.write((const char *) &record, sizeof(record));
+    out.write(url.data(), (std::streamsize) url.size());
+    out.write(headers.data(), (std::streamsize) headers.size());
+    out.write(body.data(), (std::streamsize) body.size());
+    out.write(zeros, (std::streamsize) (padded(size) - size));
+    records++;
+}
+
+bool HttpArchiveWriter::close() {
+    if (!out.is_open()) {
+        return true;
+    }
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Failed to write HTTP archive " << path << std::endl;
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Failed to write HTTP archive " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HttpArchiveWriter::discard() {
+    if (!out.is_open()) {
+        return;
+    }
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    out.close();
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+}
+
+HttpArchive::~HttpArchive() {
+    close();
+}
+
+void HttpArchive::close() {
+    if (base) {
+        munmap((void *) base, length);
+    }
+    base = nullptr;
+    length = 0;
+    responses.clear();
+}
+
+bool HttpArchive::open(const std::filesystem::path &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open HTTP archive " << path << std::endl;
+        return false;
+    }
+    struct stat info{};
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(HttpArchiveHeader)) {
+        mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Cannot map HTTP archive " << path << std::endl;
+        return false;
+    }
+    base = (const char *) mapped;
+    length = (size_t) info.st_size;
+    // Replays read each body once, front to back
+    madvise((void *) base, length, MADV_SEQUENTIAL);
+
+    const auto *header = (const HttpArchiveHeader *) base;
+    bool valid = std::memcmp(header->magic, archiveMagic, sizeof(archiveMagic)) == 0 &&
+                 header->version == httpArchiveVersion && header->byteOrder == archiveByteOrder;
+
+    size_t offset = sizeof(HttpArchiveHeader);
+    while (valid && offset < length) {
+        valid = length - offset >= sizeof(HttpArchiveRecord);
+        if (!valid) {
+            break;
+        }
+        HttpArchiveRecord record{};
+        std::memcpy(&record, base + offset, sizeof(record));
+        offset += sizeof(record);
+
+        uint64_t size = (uint64_t) record.urlSize + record.headersSize + record.bodySize;
+        valid = record.bodySize <= length && padded(size) <= length - offset;
+        if (!valid) {
+            break;
+        }
+        const char *data = base + offset;
+        std::string_view url(data, record.urlSize);
+        responses[url] = {record.status, {data + record.urlSize, record.headersSize},
+                          {data + record.urlSize + record.headersSize, record.bodySize}};
+        offset += padded(size);
+    }
+    if (!valid) {
+        std::cerr << "HTTP archive " << path << " is damaged or from another version; record it again" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+const ArchivedResponse *HttpArchive::find(std::string_view url) const {
+    auto it = responses.find(url);
+    return it == responses.end() ? nullptr : &it->second;
+}
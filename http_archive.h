@@ -0,0 +1,89 @@
+#ifndef HTTP_ARCHIVE_H
+#define HTTP_ARCHIVE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+constexpr uint32_t httpArchiveVersion = 1;
+
+// On-disk layout: an HttpArchiveHeader, then one record per response. Each record is an HttpArchiveRecord followed
+// by the URL, the raw header block and the body, padded to 8 bytes. Integers are in host byte order, like the
+// snapshot.
+struct HttpArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written
+};
+
+struct HttpArchiveRecord {
+    uint32_t urlSize;
+    uint32_t headersSize;
+    uint64_t bodySize;
+    int32_t status;
+    uint32_t reserved;
+};
+
+struct ArchivedResponse {
+    long status = 0;
+    std::string_view headers; // header lines of the final response, '\n' separated
+    std::string_view body;
+};
+
+// Records every response a client serves into one archive file. Records go to a temporary file that close()
+// renames over the path, so a replay never sees a half-written archive. A recording that is not closed, because
+// the run failed or threw, is discarded and leaves any earlier archive at the path alone.
+class HttpArchiveWriter {
+public:
+    HttpArchiveWriter() = default;
+    ~HttpArchiveWriter();
+    HttpArchiveWriter(const HttpArchiveWriter &) = delete;
+    HttpArchiveWriter &operator=(const HttpArchiveWriter &) = delete;
+
+    bool open(const std::filesystem::path &path);
+    void add(std::string_view url, long status, std::string_view headers, std::string_view body);
+    bool close();
+    void discard();
+
+    size_t size() const { return records; }
+
+private:
+    std::filesystem::path path;
+    std::ofstream out;
+    size_t records = 0;
+};
+
+// Read-only view of a mapped archive. open() indexes the records by URL, a later record of a URL replacing an
+// earlier one; the responses point into the mapping.
+class HttpArchive {
+public:
+    HttpArchive() = default;
+    ~HttpArchive();
+    HttpArchive(const HttpArchive &) = delete;
+    HttpArchive &operator=(const HttpArchive &) = delete;
+
+    bool open(const std::filesystem::path &path);
+    void close();
+
+    const ArchivedResponse *find(std::string_view url) const;
+    size_t size() const { return responses.size(); }
+
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    std::unordered_map<std::string_view, ArchivedResponse> responses;
+};
+
+// Network timing a replay simulates: every transfer waits latency before its first byte and then arrives at
+// bytesPerSecond (0 for no limit), with at most maxInFlight transfers running at once as on the network
+struct ReplayTiming {
+    std::chrono::milliseconds latency{0};
+    double bytesPerSecond = 0;
+};
+
+#endif // HTTP_ARCHIVE_H
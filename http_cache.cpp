@@ -0,0 +1,162 @@
+#include "http_cache.h"
+
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+
+
+using json = nlohmann::json;
+
+static int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+}
+
+// FNV-1a, so cache file names stay stable across builds and platforms
+static uint64_t hashUrl(const std::string &url) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c: url) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool writeFileAtomically(const std::filesystem::path &path, const std::string &contents) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.write(contents.data(), (std::streamsize) contents.size())) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+HttpCache::HttpCache(std::filesystem::path directory) : directory(std::move(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(this->directory, ec);
+    if (ec) {
+        std::cerr << "Failed to create HTTP cache directory " << this->directory << ": " << ec.message() << std::endl;
+    }
+}
+
+void HttpCache::setTtl(const std::string &urlPrefix, std::chrono::seconds ttl) {
+    std::erase_if(ttls, [&urlPrefix](const auto &rule) { return rule.first == urlPrefix; });
+    ttls.emplace_back(urlPrefix, ttl);
+}
+
+std::chrono::seconds HttpCache::ttlFor(const std::string &url) const {
+    std::chrono::seconds ttl{0};
+    size_t longest = 0;
+    for (const auto &[prefix, prefixTtl]: ttls) {
+        if (prefix.size() >= longest && url.starts_with(prefix)) {
+            longest = prefix.size();
+            ttl = prefixTtl;
+        }
+    }
+    return ttl;
+}
+
+bool HttpCache::isFresh(const CacheEntry &entry) const {
+    return unixNow() - entry.storedAt < ttlFor(entry.url).count();
+}
+
+std::filesystem::path HttpCache::pathFor(const std::string &url, const char *extension) const {
+    std::ostringstream name;
+    name << std::hex << hashUrl(url) << extension;
+    return directory / name.str();
+}
+
+std::optional<CacheEntry> HttpCache::lookup(const std::string &url) const {
+    std::ifstream in(pathFor(url, ".meta"));
+    if (!in || !std::filesystem::exists(pathFor(url, ".body"))) {
+        return std::nullopt;
+    }
+
+    json meta = json::parse(in, nullptr, false);
+    if (meta.is_discarded() || meta.value("url", "") != url) {
+        return std::nullopt;
+    }
+
+    CacheEntry entry;
+    entry.url = url;
+    entry.etag = meta.value("etag", "");
+    entry.lastModified = meta.value("last_modified", "");
+    entry.storedAt = meta.value("stored_at", int64_t{0});
+    return entry;
+}
+
+bool HttpCache::readBody(const std::string &url,
+                         const std::function<void(const char *data, size_t size)> &sink) const {
+    std::ifstream in(pathFor(url, ".body"), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char block[64 * 1024];
+    while (in.read(block, sizeof(block)) || in.gcount() > 0) {
+        sink(block, (size_t) in.gcount());
+    }
+    return true;
+}
+
+std::string HttpCache::readBody(const std::string &url) const {
+    std::ifstream in(pathFor(url, ".body"), std::ios::binary);
+    if (!in) {
+        return "";
+    }
+    in.seekg(0, std::ios::end);
+    std::string body((size_t) in.tellg(), '\0');
+    in.seekg(0, std::ios::beg);
+    in.read(body.data(), (std::streamsize) body.size());
+    return body;
+}
+
+void HttpCache::writeMeta(const CacheEntry &entry) const {
+    json meta = {{"url", entry.url},
+                 {"etag", entry.etag},
+                 {"last_modified", entry.lastModified},
+                 {"stored_at", entry.storedAt}};
+    if (!writeFileAtomically(pathFor(entry.url, ".meta"), meta.dump())) {
+        std::cerr << "Failed to write HTTP cache metadata for " << entry.url << std::endl;
+    }
+}
+
+void HttpCache::store(const CacheEntry &entry, const std::string &body) const {
+    CacheEntry stored = entry;
+    stored.storedAt = unixNow();
+    // Body first: a metadata file is only ever visible next to a complete body
+    if (!writeFileAtomically(pathFor(entry.url, ".body"), body)) {
+        std::cerr << "Failed to write HTTP cache body for " << entry.url << std::endl;
+        return;
+    }
+    writeMeta(stored);
+}
+
+std::filesystem::path HttpCache::pendingPath(const std::string &url) const { return pathFor(url, ".body.part"); }
+
+void HttpCache::commitPending(const CacheEntry &entry) const {
+    std::error_code ec;
+    std::filesystem::rename(pendingPath(entry.url), pathFor(entry.url, ".body"), ec);
+    if (ec) {
+        std::cerr << "Failed to write HTTP cache body for " << entry.url << ": " << ec.message() << std::endl;
+        return;
+    }
+    CacheEntry stored = entry;
+    stored.storedAt = unixNow();
+    writeMeta(stored);
+}
+
+void HttpCache::discardPending(const std::string &url) const {
+    std::error_code ec;
+    std::filesystem::remove(pendingPath(url), ec);
+}
+
+void HttpCache::touch(CacheEntry &entry) const {
+    entry.storedAt = unixNow();
+    writeMeta(entry);
+}
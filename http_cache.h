@@ -0,0 +1,52 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+struct CacheEntry {
+    std::string url;
+    std::string etag;
+    std::string lastModified;
+    int64_t storedAt = 0; // unix seconds of the last 200 or 304 from the origin
+};
+
+// Persistent response cache kept in a directory, one body file plus one metadata file per URL.
+// Entries younger than the TTL of their URL are served without touching the network; older ones
+// are revalidated with If-None-Match / If-Modified-Since.
+class HttpCache {
+public:
+    explicit HttpCache(std::filesystem::path directory);
+
+    // The longest matching prefix wins. URLs without a matching prefix always revalidate.
+    void setTtl(const std::string &urlPrefix, std::chrono::seconds ttl);
+    std::chrono::seconds ttlFor(const std::string &url) const;
+    bool isFresh(const CacheEntry &entry) const;
+
+    std::optional<CacheEntry> lookup(const std::string &url) const;
+    std::string readBody(const std::string &url) const;
+    // Streams the stored body in fixed-size blocks instead of loading it whole
+    bool readBody(const std::string &url, const std::function<void(const char *data, size_t size)> &sink) const;
+    void store(const CacheEntry &entry, const std::string &body) const;
+    void touch(CacheEntry &entry) const;
+
+    // Streaming writers append to pendingPath() while the body downloads, then commit or discard it
+    std::filesystem::path pendingPath(const std::string &url) const;
+    void commitPending(const CacheEntry &entry) const;
+    void discardPending(const std::string &url) const;
+
+private:
+    std::filesystem::path pathFor(const std::string &url, const char *extension) const;
+    void writeMeta(const CacheEntry &entry) const;
+
+    std::filesystem::path directory;
+    std::vector<std::pair<std::string, std::chrono::seconds>> ttls;
+};
+
+#endif // HTTP_CACHE_H
@@ -0,0 +1,587 @@
+#include "http_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iostream>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <tuple>
+
+
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *userp) {
+    userp->append((char *) contents, size * nmemb);
+    return size * nmemb;
+}
+
+// Error pages that will be retried are dropped, so the sink only ever sees a body worth parsing
+static bool isRetryableStatus(long status) {
+    return status == 429 || status >= 500;
+}
+
+size_t HttpClient::SinkCallback(char *data, size_t size, size_t nmemb, Transfer *transfer) {
+    size_t length = size * nmemb;
+    if (isRetryableStatus(transfer->status)) {
+        return length;
+    }
+    (*transfer->sink)(transfer->index, data, length);
+    transfer->delivered += length;
+    if (transfer->pendingBody.is_open()) {
+        transfer->pendingBody.write(data, (std::streamsize) length);
+    }
+    return length;
+}
+
+// Records the validators and header lines of the final response; redirects restart the header block with a new status line
+size_t HttpClient::HeaderCallback(char *buffer, size_t size, size_t nitems, Transfer *transfer) {
+    size_t length = size * nitems;
+    std::string_view line(buffer, length);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+        line.remove_suffix(1);
+    }
+
+    auto headerValue = [&line](std::string_view name) -> std::optional<std::string> {
+        if (line.size() <= name.size() ||
+            !std::ranges::equal(line.substr(0, name.size()), name,
+                                [](char a, char b) { return std::tolower((unsigned char) a) == b; })) {
+            return std::nullopt;
+        }
+        std::string_view value = line.substr(name.size());
+        while (!value.empty() && value.front() == ' ') {
+            value.remove_prefix(1);
+        }
+        return std::string(value);
+    };
+
+    auto number = [](const std::string &text, auto &value) {
+        return std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc();
+    };
+
+    if (line.starts_with("HTTP/")) {
+        transfer->response.headers.clear();
+        transfer->validators.etag.clear();
+        transfer->validators.lastModified.clear();
+        transfer->status = 0;
+        if (size_t space = line.find(' '); space != std::string_view::npos) {
+            std::string code(line.substr(space + 1, 3));
+            number(code, transfer->status);
+        }
+    } else if (auto etag = headerValue("etag:")) {
+        transfer->validators.etag = *etag;
+    } else if (auto lastModified = headerValue("last-modified:")) {
+        transfer->validators.lastModified = *lastModified;
+    } else if (auto contentLength = headerValue("content-length:"); contentLength && transfer->sink == nullptr) {
+        // The length on the wire; a compressed body inflates past it, but most of the regrowth is still saved
+        size_t bytes = 0;
+        if (number(*contentLength, bytes)) {
+            transfer->response.body.reserve(std::min<size_t>(bytes, 256 << 20));
+        }
+    } else if (auto retryAfter = headerValue("retry-after:")) {
+        int seconds = 0;
+        if (number(*retryAfter, seconds)) {
+            transfer->retryAfter = std::chrono::seconds(std::clamp(seconds, 0, 60));
+        }
+    }
+    if (!line.empty() && !line.starts_with("HTTP/")) {
+        transfer->response.headers.append(line).push_back('\n');
+    }
+    return length;
+}
+
+// Timing breakdown of a finished transfer, read before the handle is reset for reuse
+static void recordTransfer(CURL *handle, const HttpResponse &response, Metrics::Clock::time_point started,
+                           int attempt) {
+    if (!metrics.isEnabled()) {
+        return;
+    }
+    curl_off_t dns = 0, connect = 0, tls = 0, firstByte = 0, total = 0, bytes = 0;
+    curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+
+    // curl reports cumulative microseconds from the start of the transfer
+    nlohmann::json args = {{"url", response.url},
+                           {"status", response.status},
+                           {"bytes", bytes},
+                           {"dns_ms", (double) dns / 1000.0},
+                           {"connect_ms", (double) (connect - dns) / 1000.0},
+                           {"tls_ms", tls > 0 ? (double) (tls - connect) / 1000.0 : 0.0},
+                           {"first_byte_ms", (double) firstByte / 1000.0},
+                           {"transfer_ms", (double) (total - firstByte) / 1000.0},
+                           {"attempt", attempt}};
+    if (!response.ok()) {
+        args["error"] = response.error;
+    }
+    metrics.span("http", "network", started, Metrics::Clock::now(), std::move(args));
+    metrics.count("http.requests");
+    metrics.count("http.bytes", bytes);
+    if (!response.ok()) {
+        metrics.count("http.failures");
+    } else if (response.status == 304) {
+        metrics.count("http.not_modified");
+    }
+}
+
+HttpClient::HttpClient(size_t maxInFlight) : maxInFlight(std::max<size_t>(1, maxInFlight)) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    setMaxInFlight(this->maxInFlight);
+}
+
+HttpClient::~HttpClient() {
+    for (CURL *handle: idleHandles) {
+        curl_easy_cleanup(handle);
+    }
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
+
+void HttpClient::setMaxInFlight(size_t limit) {
+    maxInFlight = std::max<size_t>(1, limit);
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) maxInFlight);
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long) maxInFlight);
+}
+
+void HttpClient::setTimeouts(std::chrono::milliseconds connect, std::chrono::milliseconds total,
+                             std::chrono::seconds stallTime) {
+    connectTimeout = connect;
+    totalTimeout = total;
+    stallTimeout = stallTime;
+}
+
+void HttpClient::configure(CURL *handle, Transfer &transfer, const std::string &url) {
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    if (transfer.sink != nullptr) {
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, SinkCallback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer.response.body);
+    }
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &transfer);
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer.headers);
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, &transfer);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    // "" offers every encoding this libcurl can decode (gzip, deflate, and brotli/zstd when built in)
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+    // Over TLS, ALPN tells right away whether a connection multiplexes, so waiting for one beats opening another.
+    // Plain HTTP only finds out from the first response, which a slow request can hold up.
+    if (url.starts_with("https://")) {
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+    }
+
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, (long) connectTimeout.count());
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, (long) totalTimeout.count());
+    curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, (long) stallTimeout.count());
+}
+
+bool HttpClient::shouldRetry(const Transfer &transfer, CURLcode result) const {
+    if (transfer.attempt >= maxAttempts || transfer.delivered > 0) {
+        return false;
+    }
+    switch (result) {
+        case CURLE_OK:
+            return isRetryableStatus(transfer.response.status);
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// 250 ms doubling per attempt, with up to the same again of random jitter so parallel retries spread out. A
+// Retry-After from the server is honoured when it asks for longer.
+std::chrono::milliseconds HttpClient::backoff(const Transfer &transfer) {
+    std::chrono::milliseconds base(250 << std::min(transfer.attempt - 1, 6));
+    std::uniform_int_distribution<long> spread(0, base.count());
+    return std::max(base + std::chrono::milliseconds(spread(jitter)),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(transfer.retryAfter));
+}
+
+CURL *HttpClient::acquireHandle() {
+    if (!idleHandles.empty()) {
+        CURL *handle = idleHandles.back();
+        idleHandles.pop_back();
+        return handle;
+    }
+    return curl_easy_init();
+}
+
+void HttpClient::releaseHandle(CURL *handle) {
+    // curl_easy_reset clears options but keeps the connection and DNS caches attached to the handle
+    curl_easy_reset(handle);
+    idleHandles.push_back(handle);
+}
+
+HttpResponse HttpClient::get(const std::string &url) {
+    HttpResponse result;
+    getAll({url}, [&result](size_t, HttpResponse &response) { result = std::move(response); });
+    return result;
+}
+
+void HttpClient::getAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse) {
+    getAll(urls, onResponse, nullptr);
+}
+
+void HttpClient::getAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse,
+                        const ChunkSink &onChunk) {
+    if (replay != nullptr) {
+        replayAll(urls, onResponse, onChunk);
+        return;
+    }
+    if (recorder == nullptr) {
+        fetchAll(urls, onResponse, onChunk);
+        return;
+    }
+
+    // Streamed bodies are collected for the archive on the way to the caller's sink
+    std::vector<std::string> bodies(urls.size());
+    ChunkSink recordChunk;
+    if (onChunk) {
+        recordChunk = [&](size_t index, const char *data, size_t size) {
+            bodies[index].append(data, size);
+            onChunk(index, data, size);
+        };
+    }
+    fetchAll(
+            urls,
+            [&](size_t index, HttpResponse &response) {
+                if (response.ok()) {
+                    recorder->add(urls[index], response.status, response.headers,
+                                  onChunk ? bodies[index] : response.body);
+                }
+                std::string().swap(bodies[index]);
+                onResponse(index, response);
+            },
+            recordChunk);
+}
+
+void HttpClient::fetchAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse,
+                          const ChunkSink &onChunk) {
+    std::vector<std::unique_ptr<Transfer>> transfers(urls.size());
+    std::vector<std::pair<Metrics::Clock::time_point, size_t>> retries; // due time, index
+    size_t next = 0;
+    size_t inFlight = 0;
+
+    auto launch = [&](size_t index) {
+        Transfer *transfer = transfers[index].get();
+        CURL *handle = acquireHandle();
+        if (handle == nullptr) {
+            transfer->response.error = "curl_easy_init() failed";
+            finishTransfer(*transfer);
+            onResponse(index, transfer->response);
+            transfers[index].reset();
+            return;
+        }
+        transfer->started = Metrics::Clock::now();
+        transfer->handle = handle;
+        configure(handle, *transfer, urls[index]);
+        curl_multi_add_handle(multi, handle);
+        inFlight++;
+    };
+
+    auto start = [&](size_t index) {
+        std::optional<CacheEntry> cached;
+        if (cache != nullptr) {
+            cached = cache->lookup(urls[index]);
+            if (cached && cache->isFresh(*cached)) {
+                auto started = Metrics::Clock::now();
+                HttpResponse hit{urls[index], 200, "", "", true, ""};
+                if (onChunk) {
+                    cache->readBody(urls[index], [&](const char *data, size_t size) { onChunk(index, data, size); });
+                } else {
+                    hit.body = cache->readBody(urls[index]);
+                }
+                metrics.span("http", "cache", started, Metrics::Clock::now(), {{"url", urls[index]}, {"cached", true}});
+                metrics.count("http.cache_hits");
+                onResponse(index, hit);
+                return;
+            }
+        }
+
+        transfers[index] = std::make_unique<Transfer>();
+        Transfer *transfer = transfers[index].get();
+        transfer->index = index;
+        transfer->response.url = urls[index];
+        transfer->validators.url = urls[index];
+        transfer->cached = std::move(cached);
+
+        if (transfer->cached) {
+            if (!transfer->cached->etag.empty()) {
+                transfer->headers = curl_slist_append(transfer->headers,
+                                                      ("If-None-Match: " + transfer->cached->etag).c_str());
+            }
+            if (!transfer->cached->lastModified.empty()) {
+                transfer->headers = curl_slist_append(
+                        transfer->headers, ("If-Modified-Since: " + transfer->cached->lastModified).c_str());
+            }
+        }
+
+        if (onChunk) {
+            transfer->sink = &onChunk;
+            if (cache != nullptr) {
+                transfer->pendingBody.open(cache->pendingPath(urls[index]), std::ios::binary | std::ios::trunc);
+            }
+        }
+        launch(index);
+    };
+
+    auto retry = [&](Transfer &transfer) {
+        auto delay = backoff(transfer);
+        transfer.attempt++;
+        transfer.response.status = 0;
+        transfer.response.body.clear();
+        transfer.response.headers.clear();
+        transfer.response.error.clear();
+        transfer.status = 0;
+        transfer.retryAfter = std::chrono::seconds(0);
+        if (transfer.pendingBody.is_open()) {
+            transfer.pendingBody.close();
+            transfer.pendingBody.open(cache->pendingPath(transfer.response.url), std::ios::binary | std::ios::trunc);
+        }
+        retries.emplace_back(Metrics::Clock::now() + delay, transfer.index);
+        metrics.count("http.retries");
+    };
+
+    while (next < urls.size() || inFlight > 0 || !retries.empty()) {
+        auto now = Metrics::Clock::now();
+        for (auto it = retries.begin(); it != retries.end() && inFlight < maxInFlight;) {
+            if (it->first <= now) {
+                size_t index = it->second;
+                it = retries.erase(it);
+                launch(index);
+            } else {
+                ++it;
+            }
+        }
+        while (inFlight < maxInFlight && next < urls.size()) {
+            start(next++);
+        }
+        if (inFlight == 0) {
+            if (!retries.empty()) {
+                std::this_thread::sleep_until(std::ranges::min(retries).first);
+            }
+            continue;
+        }
+
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &running);
+        if (mc != CURLM_OK) {
+            // The multi handle cannot make progress, so every request not answered yet fails with it
+            std::string error = std::string("curl_multi_perform() failed: ") + curl_multi_strerror(mc);
+            std::cerr << error << std::endl;
+            for (size_t index = 0; index < urls.size(); ++index) {
+                if (transfers[index]) {
+                    Transfer &transfer = *transfers[index];
+                    if (transfer.handle != nullptr) {
+                        curl_multi_remove_handle(multi, transfer.handle);
+                        releaseHandle(transfer.handle);
+                        transfer.handle = nullptr;
+                    }
+                    transfer.response.error = error;
+                    metrics.count("http.failures");
+                    finishTransfer(transfer);
+                    onResponse(index, transfer.response);
+                    transfers[index].reset();
+                } else if (index >= next) {
+                    HttpResponse failed;
+                    failed.url = urls[index];
+                    failed.error = error;
+                    metrics.count("http.failures");
+                    onResponse(index, failed);
+                }
+            }
+            return;
+        }
+
+        CURLMsg *msg;
+        int queued = 0;
+        while ((msg = curl_multi_info_read(multi, &queued)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL *handle = msg->easy_handle;
+            CURLcode res = msg->data.result;
+
+            Transfer *transfer = nullptr;
+            curl_easy_getinfo(handle, CURLINFO_PRIVATE, &transfer);
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+            if (res != CURLE_OK) {
+                transfer->response.error = curl_easy_strerror(res);
+            }
+
+            recordTransfer(handle, transfer->response, transfer->started, transfer->attempt);
+            transfer->handle = nullptr;
+            curl_multi_remove_handle(multi, handle);
+            releaseHandle(handle);
+            inFlight--;
+
+            if (shouldRetry(*transfer, res)) {
+                retry(*transfer);
+                continue;
+            }
+
+            finishTransfer(*transfer);
+            size_t index = transfer->index;
+            onResponse(index, transfer->response);
+            transfers[index].reset();
+        }
+
+        if (inFlight > 0 && running > 0) {
+            // Wake up in time for the next retry that is due
+            int timeout = 1000;
+            if (!retries.empty()) {
+                auto wait = std::ranges::min(retries).first - Metrics::Clock::now();
+                timeout = (int) std::clamp<int64_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(wait).count(), 0, 1000);
+            }
+            curl_multi_poll(multi, nullptr, 0, timeout, nullptr);
+        }
+    }
+}
+
+// Runs the transfers against a simulated network: each of at most maxInFlight slots waits the latency, then the
+// body arrives in blocks at the configured rate. Events are played in time order, so streamed chunks of
+// concurrent transfers interleave as they would on the wire.
+void HttpClient::replayAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse,
+                           const ChunkSink &onChunk) {
+    static constexpr size_t blockSize = 16 * 1024;
+    using Clock = Metrics::Clock;
+
+    struct Event {
+        Clock::time_point due;
+        size_t index;
+        size_t offset; // body bytes delivered before this event
+
+        bool operator>(const Event &other) const { return std::tie(due, index) > std::tie(other.due, other.index); }
+    };
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events;
+    std::vector<Clock::time_point> started(urls.size());
+    size_t next = 0;
+
+    auto transferTime = [this](size_t bytes) {
+        if (replayTiming.bytesPerSecond <= 0) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((double) bytes / replayTiming.bytesPerSecond));
+    };
+    auto start = [&](Clock::time_point now) {
+        if (next < urls.size()) {
+            started[next] = now;
+            events.push({now + replayTiming.latency, next++, 0});
+        }
+    };
+
+    auto now = Clock::now();
+    for (size_t i = 0; i < maxInFlight; ++i) {
+        start(now);
+    }
+
+    while (!events.empty()) {
+        Event event = events.top();
+        events.pop();
+        std::this_thread::sleep_until(event.due);
+
+        const ArchivedResponse *archived = replay->find(urls[event.index]);
+        size_t bodySize = archived ? archived->body.size() : 0;
+        if (archived && onChunk && event.offset < bodySize) {
+            size_t size = std::min(blockSize, bodySize - event.offset);
+            onChunk(event.index, archived->body.data() + event.offset, size);
+            events.push({event.due + transferTime(size), event.index, event.offset + size});
+            continue;
+        }
+        if (archived && !onChunk && event.offset == 0 && bodySize > 0) {
+            events.push({event.due + transferTime(bodySize), event.index, bodySize});
+            continue;
+        }
+
+        HttpResponse response;
+        response.url = urls[event.index];
+        if (archived) {
+            response.status = archived->status;
+            response.headers = archived->headers;
+            if (!onChunk) {
+                response.body = archived->body;
+            }
+        } else {
+            response.error = "not in the replay archive";
+            metrics.count("http.failures");
+        }
+        metrics.span("http", "replay", started[event.index], Clock::now(),
+                     {{"url", urls[event.index]}, {"status", response.status}, {"bytes", bodySize}});
+        metrics.count("http.replayed");
+        onResponse(event.index, response);
+        start(Clock::now());
+    }
+}
+
+void HttpClient::finishTransfer(Transfer &transfer) {
+    curl_slist_free_all(transfer.headers);
+    transfer.headers = nullptr;
+
+    HttpResponse &response = transfer.response;
+    bool streamed = transfer.sink != nullptr;
+    bool pendingWritten = false;
+    if (transfer.pendingBody.is_open()) {
+        transfer.pendingBody.close();
+        pendingWritten = !transfer.pendingBody.fail();
+    }
+
+    if (cache == nullptr) {
+        return;
+    }
+
+    if (response.ok() && response.status == 304 && transfer.cached) {
+        if (streamed) {
+            cache->readBody(response.url, [&transfer](const char *data, size_t size) {
+                (*transfer.sink)(transfer.index, data, size);
+            });
+        } else {
+            response.body = cache->readBody(response.url);
+        }
+        response.status = 200;
+        response.fromCache = true;
+        cache->touch(*transfer.cached);
+    } else if (response.ok() && response.status == 200) {
+        if (!streamed) {
+            cache->store(transfer.validators, response.body);
+            return;
+        }
+        if (pendingWritten) {
+            cache->commitPending(transfer.validators);
+            return;
+        }
+    }
+
+    if (streamed) {
+        cache->discardPending(response.url);
+    }
+}
+
+std::string makeHttpRequest(HttpClient &http, const std::string &url) {
+    HttpResponse response = http.get(url);
+    if (!response.ok()) {
+        std::cerr << "HTTP request to " << url << " failed: " << response.error << std::endl;
+        return "";
+    }
+    return std::move(response.body);
+}
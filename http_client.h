@@ -0,0 +1,127 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <algorithm>
+#include <chrono>
+#include <curl/curl.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "http_archive.h"
+#include "http_cache.h"
+#include "metrics.h"
+
+
+struct HttpResponse {
+    std::string url;
+    long status = 0;
+    std::string body;
+    std::string error; // curl error message, empty when the transfer completed
+    bool fromCache = false;
+    std::string headers; // header lines of the final response, '\n' separated; empty for cache hits
+
+    bool ok() const { return error.empty(); }
+};
+
+// Shared HTTP client built on a single curl_multi handle. Easy handles are pooled and reused so
+// DNS results and keep-alive connections survive across requests to the same host. Responses are
+// requested compressed and over HTTP/2 where the server supports it, with transfers to one host
+// multiplexed on a single connection.
+class HttpClient {
+public:
+    explicit HttpClient(size_t maxInFlight = 6);
+    ~HttpClient();
+
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    HttpResponse get(const std::string &url);
+
+    using ResponseHandler = std::function<void(size_t index, HttpResponse &response)>;
+    using ChunkSink = std::function<void(size_t index, const char *data, size_t size)>;
+
+    // Fetches all URLs with at most maxInFlight transfers running at once. onResponse is called on the
+    // calling thread as each transfer finishes, so responses arrive in completion order, not request order.
+    void getAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse);
+
+    // Streaming variant: body bytes go to onChunk as they arrive (cached bodies are replayed in blocks) and
+    // are never buffered, so the responses passed to onResponse have an empty body.
+    void getAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse, const ChunkSink &onChunk);
+
+    void setMaxInFlight(size_t limit);
+    size_t getMaxInFlight() const { return maxInFlight; }
+
+    // A transfer fails once connecting takes longer than connect, the whole attempt longer than total, or it
+    // stalls below 1 KB/s for stallTime
+    void setTimeouts(std::chrono::milliseconds connect, std::chrono::milliseconds total,
+                     std::chrono::seconds stallTime = std::chrono::seconds(30));
+
+    // Attempts per URL for transient failures (connection errors, timeouts, 429 and 5xx), with exponential
+    // backoff between them. A streamed transfer is only retried if none of its body has reached the sink.
+    void setMaxAttempts(int attempts) { maxAttempts = std::max(1, attempts); }
+
+    // Successful responses are stored in the cache and later requests revalidate against it
+    void setCache(HttpCache *responseCache) { cache = responseCache; }
+
+    // Every response served from now on, cache hits included, is added to the archive. Failed transfers are not.
+    void setRecorder(HttpArchiveWriter *archive) { recorder = archive; }
+
+    // Serves every request from the archive instead of the cache and the network. A URL missing from the archive
+    // fails like a transfer would. The simulated timing paces the responses and streamed chunks.
+    void setReplay(const HttpArchive *archive, ReplayTiming timing = {}) {
+        replay = archive;
+        replayTiming = timing;
+    }
+
+private:
+    struct Transfer {
+        size_t index;
+        HttpResponse response;
+        std::optional<CacheEntry> cached;
+        CacheEntry validators;
+        curl_slist *headers = nullptr;
+        const ChunkSink *sink = nullptr;
+        CURL *handle = nullptr; // while added to the multi handle
+        std::ofstream pendingBody; // cache copy of a streamed body
+        Metrics::Clock::time_point started;
+        long status = 0;      // from the latest status line, before the transfer completes
+        size_t delivered = 0; // body bytes passed to sink
+        int attempt = 1;
+        std::chrono::seconds retryAfter{0};
+    };
+
+    static size_t HeaderCallback(char *buffer, size_t size, size_t nitems, Transfer *transfer);
+    static size_t SinkCallback(char *data, size_t size, size_t nmemb, Transfer *transfer);
+    void configure(CURL *handle, Transfer &transfer, const std::string &url);
+    bool shouldRetry(const Transfer &transfer, CURLcode result) const;
+    std::chrono::milliseconds backoff(const Transfer &transfer);
+    void finishTransfer(Transfer &transfer);
+    void fetchAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse, const ChunkSink &onChunk);
+    void replayAll(const std::vector<std::string> &urls, const ResponseHandler &onResponse, const ChunkSink &onChunk);
+
+    CURL *acquireHandle();
+    void releaseHandle(CURL *handle);
+
+    CURLM *multi;
+    std::vector<CURL *> idleHandles;
+    size_t maxInFlight;
+    HttpCache *cache = nullptr;
+    HttpArchiveWriter *recorder = nullptr;
+    const HttpArchive *replay = nullptr;
+    ReplayTiming replayTiming;
+    std::chrono::milliseconds connectTimeout{10000};
+    std::chrono::milliseconds totalTimeout{180000};
+    std::chrono::seconds stallTimeout{30};
+    int maxAttempts = 3;
+    std::mt19937 jitter{std::random_device{}()};
+};
+
+// Performs a GET through the shared client, logging failures. Returns an empty string on error.
+std::string makeHttpRequest(HttpClient &http, const std::string &url);
+
+#endif // HTTP_CLIENT_H
@@ -1,654 +1,489 @@
 #include <SQLiteCpp/SQLiteCpp.h>
 #include <algorithm>
-#include <curl/curl.h>
-#include <iomanip>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <csignal>
+#include <fstream>
 #include <iostream>
-#include <libxml/HTMLparser.h>
-#include <libxml/xpath.h>
-#include <nlohmann/json.hpp>
-#include <regex>
-#include <set>
+#include <limits>
 #include <string>
+#include <thread>
 #include <vector>
 
-
-using json = nlohmann::json;
-
-struct Player {
-    std::string id;
-    std::string full_name;
-    std::string position;
-    std::string nfl_team;
-    std::string fantasy_team;
-    int years_exp;
-    int draft_year;
-    int draft_round;
-    int draft_pick;
-    std::string draft_team;
-    bool is_drafted;
-    int contract_expires;
+#include "draft_store.h"
+#include "fantasy.h"
+#include "http_archive.h"
+#include "http_cache.h"
+#include "http_client.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "players_ingest.h"
+#include "report_export.h"
+#include "server.h"
+#include "snapshot.h"
+
+
+struct Options {
+    std::vector<std::string> leagueIds;
+    bool refreshPlayers = false;
+    bool bulkLoad = false;
+    bool reportFromSnapshot = false;
+    bool inMemory = false;
+    std::string databasePath = "fantasy_league.db";
+    std::string snapshotPath = "fantasy_snapshot.bin";
+    std::string socketPath;
+    std::chrono::minutes refreshInterval{30};
+    DraftSource draftSource = DraftSource::Wikitext;
+    std::string metricsPath;
+    std::string tracePath;
+    std::string recordPath;
+    std::string replayPath;
+    ReplayTiming replayTiming;
+    std::string exportPath;
+    std::string exportQuery;
+    ExportFormat exportFormat = ExportFormat::Csv;
 };
 
-std::vector<std::string> playerColumns;
-std::vector<Player> players;
-
-// Function declarations
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *userp);
-std::string makeHttpRequest(const std::string &url);
-json safeJsonParse(const std::string &jsonString, const std::string &errorContext);
-void createPlayersTable(SQLite::Database &db, const std::vector<std::string> &columns);
-void createLeagueTables(SQLite::Database &db);
-void fetchAndStorePlayersFromSleeper(SQLite::Database &db);
-void fetchAndStoreLeagueData(SQLite::Database &db, const std::string &league_id);
-void storePlayersInMemory(SQLite::Database &db);
-std::string cleanName(const std::string &name);
-std::pair<int, int> getDraftYearRange(const std::vector<Player> &players);
-bool namesMatch(const std::string &name1, const std::string &name2);
-void fetchDraftInformation(int year);
-void createProcessedPlayersTable(SQLite::Database &db);
-void storeProcessedPlayers(SQLite::Database &db);
-void displayRecentHighDraftPlayers(const SQLite::Database &db);
-int getCurrentYear();
-
-int main() {
-    try {
-        SQLite::Database db("fantasy_league.db", SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
-
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-
-        std::string league_id;
-        std::cout << "Enter your Sleeper league ID: ";
-        std::cin >> league_id;
-
-        std::cout << "Do you want to update the player database from Sleeper? (Y/N): ";
-        std::string response;
-        std::cin >> response;
-
-        if (response == "Y" || response == "y") {
-            fetchAndStorePlayersFromSleeper(db);
-        } else {
-            std::cout << "Skipping player database update." << std::endl;
-            SQLite::Statement query(db, "PRAGMA table_info(players)");
-            while (query.executeStep()) {
-                playerColumns.emplace_back(query.getColumn(1).getText());
-            }
-        }
-
-        createLeagueTables(db);
-        fetchAndStoreLeagueData(db, league_id);
-
-        storePlayersInMemory(db);
-
-
-        auto [startYear, endYear] = getDraftYearRange(players);
-        std::cout << "Fetching draft information for years " << startYear << " to " << endYear << std::endl;
-
-
-        for (int year = startYear; year <= endYear; ++year) {
-            fetchDraftInformation(year);
-        }
-
-
-        createProcessedPlayersTable(db);
-
-
-        storeProcessedPlayers(db);
-
-
-        displayRecentHighDraftPlayers(db);
-
-        curl_global_cleanup();
-
-
-        std::cout << "\nPress Enter to exit...";
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        std::cin.get();
-
-    } catch (std::exception &e) {
-        std::cout << "Exception: " << e.what() << std::endl;
-        std::cout << "\nPress Enter to exit...";
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        std::cin.get();
-        return 1;
-    }
-
-    return 0;
+static void printUsage(const char *program) {
+    std::cerr << "usage: " << program << " [--league ID]... [--leagues-file FILE] [--refresh-players] [--bulk-load]\n"
+              << "       [--db FILE] [--in-memory] [--snapshot FILE] [--report-from-snapshot] [--serve SOCKET]\n"
+              << "       [--refresh-minutes N] [--draft-source wikitext|html] [--metrics FILE] [--trace FILE]\n"
+              << "       [--record FILE | --replay FILE [--replay-latency MS] [--replay-bandwidth KBPS]]\n"
+              << "       [--export FILE|- [--export-format csv|ndjson] [--export-query QUERY]]\n\n"
+              << "Without --league or --leagues-file the league ID and player refresh are asked for interactively.\n"
+              << "--bulk-load rebuilds the players table from the dump instead of updating changed players in place.\n"
+              << "--in-memory runs every stage against an in-memory copy of the database and writes it back to the\n"
+              << "file in one step after each successful run.\n"
+              << "Every run saves its results to the snapshot file; --report-from-snapshot prints the report from it\n"
+              << "without the database or network, for the given leagues or all leagues in it.\n"
+              << "--serve keeps running: it answers report queries on a Unix socket (a line such as\n"
+              << "'league=ID from=2023 max_round=2 position=WR', or GET /report?league=ID) and refreshes the given\n"
+              << "leagues every --refresh-minutes (default 30) in the background.\n"
+              << "Draft picks are read from each year's page wikitext, falling back to the rendered page when the\n"
+              << "wikitext has no picks table; --draft-source html always uses the rendered page.\n"
+              << "--metrics writes counters and stage timings as JSON at exit, --trace the same spans as a Chrome trace.\n"
+              << "--record archives every HTTP response of a successful run in FILE; --replay serves them back from it\n"
+              << "without the network or the cache, optionally delayed by a per-request latency and limited to KBPS per\n"
+              << "transfer.\n"
+              << "--export writes the stored processed_players rows of the given leagues (all when none are given) to\n"
+              << "FILE or stdout without fetching anything. The query filters, picks columns and sorts, for example\n"
+              << "'from=2020 max_round=2 position=WR columns=league_id,full_name,draft_year sort=-draft_year limit=100'."
+              << std::endl;
 }
 
-
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *userp) {
-    userp->append((char *) contents, size * nmemb);
-    return size * nmemb;
+static void addLeague(Options &options, const std::string &league_id) {
+    if (!league_id.empty() && std::ranges::find(options.leagueIds, league_id) == options.leagueIds.end()) {
+        options.leagueIds.push_back(league_id);
+    }
 }
 
-std::string makeHttpRequest(const std::string &url) {
-    std::string readBuffer;
-    if (CURL *curl = curl_easy_init()) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        CURLcode res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-            return "";
+// One league ID per line; blank lines and lines starting with # are skipped
+static bool readLeaguesFile(const std::string &path, Options &options) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open leagues file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
         }
+        auto last = line.find_last_not_of(" \t\r");
+        addLeague(options, line.substr(first, last - first + 1));
     }
-    return readBuffer;
+    return true;
 }
 
-json safeJsonParse(const std::string &jsonString, const std::string &errorContext) {
-    try {
-        return json::parse(jsonString);
-    } catch (const json::parse_error &e) {
-        std::cerr << "JSON parse error in " << errorContext << ": " << e.what() << std::endl;
-        std::cerr << "Response: " << jsonString.substr(0, 100) << "..." << std::endl;
-        return json();
+static bool parseArguments(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--league" && hasValue) {
+            addLeague(options, argv[++i]);
+        } else if (arg == "--leagues-file" && hasValue) {
+            if (!readLeaguesFile(argv[++i], options)) {
+                return false;
+            }
+        } else if (arg == "--refresh-players") {
+            options.refreshPlayers = true;
+        } else if (arg == "--bulk-load") {
+            options.refreshPlayers = true;
+            options.bulkLoad = true;
+        } else if (arg == "--db" && hasValue) {
+            options.databasePath = argv[++i];
+        } else if (arg == "--in-memory") {
+            options.inMemory = true;
+        } else if (arg == "--snapshot" && hasValue) {
+            options.snapshotPath = argv[++i];
+        } else if (arg == "--report-from-snapshot") {
+            options.reportFromSnapshot = true;
+        } else if (arg == "--serve" && hasValue) {
+            options.socketPath = argv[++i];
+        } else if (arg == "--refresh-minutes" && hasValue) {
+            std::string value = argv[++i];
+            int minutes = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), minutes);
+            if (ec != std::errc() || end != value.data() + value.size() || minutes <= 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.refreshInterval = std::chrono::minutes(minutes);
+        } else if (arg == "--draft-source" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "wikitext" && value != "html") {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.draftSource = value == "html" ? DraftSource::Html : DraftSource::Wikitext;
+        } else if (arg == "--record" && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            options.replayPath = argv[++i];
+        } else if ((arg == "--replay-latency" || arg == "--replay-bandwidth") && hasValue) {
+            std::string value = argv[++i];
+            int number = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+            if (ec != std::errc() || end != value.data() + value.size() || number < 0) {
+                printUsage(argv[0]);
+                return false;
+            }
+            if (arg == "--replay-latency") {
+                options.replayTiming.latency = std::chrono::milliseconds(number);
+            } else {
+                options.replayTiming.bytesPerSecond = number * 1024.0;
+            }
+        } else if (arg == "--export" && hasValue) {
+            options.exportPath = argv[++i];
+        } else if (arg == "--export-format" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "csv" && value != "ndjson") {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.exportFormat = value == "ndjson" ? ExportFormat::Ndjson : ExportFormat::Csv;
+        } else if (arg == "--export-query" && hasValue) {
+            options.exportQuery = argv[++i];
+        } else if (arg == "--metrics" && hasValue) {
+            options.metricsPath = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (!options.recordPath.empty() && !options.replayPath.empty()) {
+        printUsage(argv[0]);
+        return false;
     }
+    return true;
 }
 
-void createPlayersTable(SQLite::Database &db, const std::vector<std::string> &columns) {
-    std::string createTableSQL = "CREATE TABLE IF NOT EXISTS players (id TEXT PRIMARY KEY";
-    for (const auto &column: columns) {
-        if (column != "id") {
-            createTableSQL += ", " + column + " TEXT";
-        }
+static void writeMetrics(const Options &options) {
+    if (!options.metricsPath.empty()) {
+        metrics.writeReport(options.metricsPath);
+    }
+    if (!options.tracePath.empty()) {
+        metrics.writeChromeTrace(options.tracePath);
     }
-    createTableSQL += ")";
-    db.exec(createTableSQL);
 }
 
-void createLeagueTables(SQLite::Database &db) {
-    db.exec("CREATE TABLE IF NOT EXISTS teams ("
-            "id INTEGER PRIMARY KEY, "
-            "name TEXT, "
-            "owner_id TEXT)");
-
-    db.exec("CREATE TABLE IF NOT EXISTS rosters ("
-            "team_id INTEGER, "
-            "player_id TEXT, "
-            "FOREIGN KEY(team_id) REFERENCES teams(id), "
-            "FOREIGN KEY(player_id) REFERENCES players(id), "
-            "PRIMARY KEY(team_id, player_id))");
+static void waitForEnter() {
+    std::cout << "\nPress Enter to exit...";
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    std::cin.get();
 }
 
-void fetchAndStorePlayersFromSleeper(SQLite::Database &db) {
-
-
-    std::string players_url = "https://api.sleeper.app/v1/players/nfl";
-    std::string players_response = makeHttpRequest(players_url);
-    json players_data = safeJsonParse(players_response, "players data");
-
-    if (players_data.is_null()) {
-        std::cerr << "Failed to fetch players data. Exiting." << std::endl;
-        return;
+static int reportFromSnapshot(const Options &options) {
+    ScopedSpan span("snapshot_report");
+    Snapshot snapshot;
+    if (!snapshot.open(options.snapshotPath)) {
+        return 1;
     }
 
-    // Collect all unique keys from the JSON objects
-    std::set<std::string> column_set;
-    for (const auto &[id, player]: players_data.items()) {
-        column_set.insert("id");
-        for (const auto &[key, value]: player.items()) {
-            column_set.insert(key);
+    std::vector<std::string> leagueIds = options.leagueIds;
+    if (leagueIds.empty()) {
+        for (size_t league = 0; league < snapshot.leagueCount(); ++league) {
+            leagueIds.emplace_back(snapshot.leagueId(league));
         }
     }
-
-
-    std::vector<std::string> columns(column_set.begin(), column_set.end());
-
-
-    createPlayersTable(db, columns);
-
-    SQLite::Transaction transaction(db);
-
-    try {
-        int count = 0;
-
-        std::stringstream ss;
-        ss << "INSERT OR REPLACE INTO players (";
-        for (size_t i = 0; i < columns.size(); ++i) {
-            ss << columns[i];
-            if (i < columns.size() - 1)
-                ss << ", ";
+    for (const auto &league_id: leagueIds) {
+        auto league = snapshot.findLeague(league_id);
+        if (!league) {
+            std::cerr << "League " << league_id << " is not in snapshot " << options.snapshotPath << std::endl;
+            return 1;
         }
-        ss << ") VALUES (";
-        for (size_t i = 0; i < columns.size(); ++i) {
-            ss << "?";
-            if (i < columns.size() - 1)
-                ss << ", ";
-        }
-        ss << ")";
-        std::string insertSQL = ss.str();
-
-        SQLite::Statement query(db, insertSQL);
-
-        for (const auto &[id, player]: players_data.items()) {
-            query.reset();
-            int columnIndex = 1;
-            for (const auto &column: columns) {
-                if (column == "id") {
-                    query.bind(columnIndex++, id);
-                } else if (player.contains(column)) {
-                    const auto &value = player[column];
-                    if (value.is_string()) {
-                        query.bind(columnIndex++, value.get<std::string>());
-                    } else if (value.is_number_integer()) {
-                        query.bind(columnIndex++, value.get<int64_t>());
-                    } else if (value.is_number_float()) {
-                        query.bind(columnIndex++, value.get<double>());
-                    } else if (value.is_boolean()) {
-                        query.bind(columnIndex++, value.get<bool>() ? 1 : 0);
-                    } else if (value.is_null()) {
-                        query.bind(columnIndex++);
-                    } else {
-                        query.bind(columnIndex++, value.dump());
-                    }
-                } else {
-                    query.bind(columnIndex++);
-                }
-            }
-
-            query.exec();
-
-            count++;
-            if (count % 100 == 0) {
-            }
+        if (leagueIds.size() > 1) {
+            std::cout << "\nLeague " << league_id << "\n";
         }
-
-        transaction.commit();
-
-    } catch (std::exception &e) {
+        displayRecentHighDraftPlayers(snapshot, *league);
     }
+    return 0;
 }
 
-void fetchAndStoreLeagueData(SQLite::Database &db, const std::string &league_id) {
-
-
-    std::string users_url = "https://api.sleeper.app/v1/league/" + league_id + "/users";
-    std::string users_response = makeHttpRequest(users_url);
-    json users_data = safeJsonParse(users_response, "users data");
-
-    if (users_data.is_null()) {
-        std::cerr << "Failed to fetch users data. Exiting." << std::endl;
-        return;
+// Writes the stored processed_players rows without touching the network
+static int exportReport(const Options &options) {
+    ExportQuery query;
+    if (std::string error = parseExportQuery(options.exportQuery, query); !error.empty()) {
+        std::cerr << "Invalid export query: " << error << std::endl;
+        return 2;
     }
+    query.leagues.insert(query.leagues.end(), options.leagueIds.begin(), options.leagueIds.end());
 
-    std::string rosters_url = "https://api.sleeper.app/v1/league/" + league_id + "/rosters";
-    std::string rosters_response = makeHttpRequest(rosters_url);
-    json rosters_data = safeJsonParse(rosters_response, "rosters data");
-
-    if (rosters_data.is_null()) {
-        std::cerr << "Failed to fetch rosters data. Exiting." << std::endl;
-        return;
+    SQLite::Database db(options.databasePath, SQLite::OPEN_READONLY);
+    int64_t rows = exportProcessedPlayers(db, query, options.exportFormat, options.exportPath);
+    if (rows < 0) {
+        return 1;
     }
-
-    SQLite::Transaction transaction(db);
-
-    try {
-        SQLite::Statement insert_team(db, "INSERT OR REPLACE INTO teams (id, name, owner_id) VALUES (?, ?, ?)");
-        for (const auto &user: users_data) {
-            insert_team.bind(1, user["user_id"].get<std::string>());
-            insert_team.bind(2, user["display_name"].get<std::string>());
-            insert_team.bind(3, user["user_id"].get<std::string>());
-            insert_team.exec();
-            insert_team.reset();
-        }
-
-        SQLite::Statement insert_roster(db, "INSERT OR REPLACE INTO rosters (team_id, player_id) VALUES (?, ?)");
-        for (const auto &roster: rosters_data) {
-            std::string team_id = roster["owner_id"].get<std::string>();
-            for (const auto &player_id: roster["players"]) {
-                insert_roster.bind(1, team_id);
-                insert_roster.bind(2, player_id.get<std::string>());
-                insert_roster.exec();
-                insert_roster.reset();
-            }
-        }
-
-        transaction.commit();
-
-    } catch (std::exception &e) {
-        std::cerr << "Error while updating league data: " << e.what() << std::endl;
+    if (options.exportPath != "-") {
+        std::cout << "Exported " << rows << " rows to " << options.exportPath << std::endl;
     }
+    return 0;
 }
 
-int getCurrentYear() {
-    time_t now = time(nullptr);
-    tm *ltm = localtime(&now);
-    return 1900 + ltm->tm_year;
-}
-
-void storePlayersInMemory(SQLite::Database &db) {
-    players.clear();
-
-
-    std::string queryString =
-            "SELECT p.id, p.full_name, p.position, t.name AS team_name, p.team AS nfl_team, p.years_exp "
-            "FROM players p "
-            "JOIN rosters r ON p.id = r.player_id "
-            "JOIN teams t ON r.team_id = t.id "
-            "WHERE p.team IS NOT NULL "
-            "AND p.position IN ('K', 'QB', 'RB', 'WR', 'TE')";
-    if (std::ranges::find(playerColumns, "status") != playerColumns.end()) {
-        queryString += " AND p.status = 'Active'";
+// Runs every stage for the given leagues and saves the results to the snapshot file. Returns false if any part
+// failed; the stages that could run still do.
+static bool processLeagues(SQLite::Database &db, ThreadPool &pool, HttpClient &http, const Options &options,
+                           bool interactive) {
+    if (!options.refreshPlayers) {
+        std::cout << "Skipping player database update." << std::endl;
+        playerColumns = loadPlayerColumns(db);
+        createPlayerIndexes(db);
     }
 
-    SQLite::Statement query(db, queryString);
-
-    while (query.executeStep()) {
-        Player player;
-        player.id = query.getColumn(0).getText();
-        player.full_name = query.getColumn(1).getText();
-        player.position = query.getColumn(2).getText();
-        player.fantasy_team = query.getColumn(3).getText();
-        player.nfl_team = query.getColumn(4).getText();
-        player.years_exp = query.getColumn(5).getInt();
-        player.is_drafted = false; // Initialize as undrafted
-        players.push_back(player);
+    createLeagueTables(db);
+    SleeperChanges changes = fetchSleeperData(db, pool, http, options.leagueIds, options.refreshPlayers,
+                                              options.bulkLoad ? IngestMode::Bulk : IngestMode::Incremental);
+
+    storePlayersInMemory(db, options.leagueIds.front());
+
+
+    createDraftTables(db);
+    createProcessedPlayersTable(db);
+
+    // With the picks unchanged since the first league was last stored, at most this run's sync changing players
+    // and no draft year left that could resolve one of its unmatched players, its rows already hold every match
+    // but those of the changed players. Only those are matched again, unless that could come out differently from
+    // a full pass, and only they and players whose roster or team name changed need writing. A draft still in progress only sends runs down the full path once it is due
+    // to be fetched again.
+    std::string inputs = draftInputsFingerprint(db);
+    std::string storedInputs = changes.players.empty() ? inputs : draftInputsFingerprint(db, true);
+    std::vector<std::string> changedPlayers = changes.players.inserted;
+    changedPlayers.insert(changedPlayers.end(), changes.players.updated.begin(), changes.players.updated.end());
+    bool unchanged = processedPlayersCurrent(db, options.leagueIds.front(), storedInputs);
+    if (unchanged) {
+        restoreDraftInformation(db, options.leagueIds.front());
+        unchanged = rematchPlayers(db, changedPlayers) && !draftYearsOutstanding(db);
+    }
+    if (unchanged) {
+        std::cout << "Draft information is up to date" << std::endl;
+    } else {
+        loadDraftInformation(db, pool, http, options.draftSource);
+        inputs = draftInputsFingerprint(db);
     }
 
 
-    std::string query2String = "SELECT id, full_name, position, team, years_exp "
-                               "FROM players "
-                               "WHERE id NOT IN (SELECT player_id FROM rosters) "
-                               "AND team IS NOT NULL "
-                               "AND position IN ('K', 'QB', 'RB', 'WR', 'TE')";
-    if (std::ranges::find(playerColumns, "status") != playerColumns.end()) {
-        query2String += " AND status = 'Active'";
+    bool stored = true;
+    SnapshotWriter snapshot(players);
+    for (const auto &league_id: options.leagueIds) {
+        if (league_id != options.leagueIds.front()) {
+            assignFantasyTeams(db, league_id);
+        }
+        if (unchanged && processedPlayersCurrent(db, league_id, storedInputs)) {
+            std::vector<std::string> moved = changedPlayers;
+            moved.insert(moved.end(), changes.players.deleted.begin(), changes.players.deleted.end());
+            for (const auto &[team, player]: changes.rosters[league_id].added) {
+                moved.push_back(player);
+            }
+            for (const auto &[team, player]: changes.rosters[league_id].dropped) {
+                moved.push_back(player);
+            }
+            for (const auto &[team, player]: changes.rosters[league_id].renamed) {
+                moved.push_back(player);
+            }
+            stored = storeProcessedPlayers(db, league_id, inputs, &moved) && stored;
+        } else {
+            stored = storeProcessedPlayers(db, league_id, inputs) && stored;
+        }
+        snapshot.addLeague(league_id, players);
+        if (interactive) {
+            displayRecentHighDraftPlayers(players);
+        }
     }
+    stored = snapshot.write(options.snapshotPath) && stored;
 
-    SQLite::Statement query2(db, query2String);
-
-    while (query2.executeStep()) {
-        Player player;
-        player.id = query2.getColumn(0).getText();
-        player.full_name = query2.getColumn(1).getText();
-        player.position = query2.getColumn(2).getText();
-        player.nfl_team = query2.getColumn(3).getText();
-        player.fantasy_team = "Unrostered";
-        player.years_exp = query2.getColumn(4).getInt();
-        player.is_drafted = false; // Initialize as undrafted
-        players.push_back(player);
+    if (options.inMemory) {
+        stored = persistDatabase(db, options.databasePath) && stored;
     }
+    return stored && !changes.playersFailed && changes.failedLeagues.empty();
 }
 
-std::string cleanName(const std::string &name) {
-    std::string cleaned = name;
-
-    std::erase(cleaned, '\xC2');
-    std::erase(cleaned, '\xA0');
-
-    while (!cleaned.empty() && std::isspace(cleaned.back())) {
-        cleaned.pop_back();
-    }
+static std::atomic<bool> stopRequested = false;
 
-    std::ranges::transform(cleaned, cleaned.begin(), [](unsigned char c) { return std::tolower(c); });
-    return cleaned;
+static void requestStop(int) {
+    stopRequested = true;
 }
 
-std::pair<int, int> getDraftYearRange(const std::vector<Player> &players) {
-    int currentYear = getCurrentYear();
-    int oldestDraftYear = currentYear;
-
-    for (const auto &player: players) {
-        if (player.years_exp > 0) {
-            int potentialDraftYear = currentYear - player.years_exp;
-            if (potentialDraftYear < oldestDraftYear) {
-                oldestDraftYear = potentialDraftYear;
-            }
+// Answers report queries until SIGINT or SIGTERM while a background thread reruns every stage each refresh
+// interval and publishes the snapshot it writes
+static int serve(Options options, SQLite::Database &db, ThreadPool &pool, HttpClient &http) {
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ReportServer server(options.socketPath);
+    auto publishSnapshot = [&server, &options] {
+        auto snapshot = std::make_shared<Snapshot>();
+        if (snapshot->open(options.snapshotPath)) {
+            server.publish(std::move(snapshot));
         }
+    };
+    // The last run's results are served while the first refresh is still running
+    if (std::filesystem::exists(options.snapshotPath)) {
+        publishSnapshot();
     }
 
-    return std::make_pair(oldestDraftYear, currentYear);
-}
-
-bool namesMatch(const std::string &name1, const std::string &name2) {
-    std::string clean1 = cleanName(name1);
-    std::string clean2 = cleanName(name2);
-
-
-    if (clean1 == clean2)
-        return true;
-
-
-    std::vector<std::string> parts1, parts2;
-    std::istringstream iss1(clean1), iss2(clean2);
-    std::string part;
-    while (iss1 >> part)
-        parts1.push_back(part);
-    while (iss2 >> part)
-        parts2.push_back(part);
-
+    options.refreshPlayers = true;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread refresher([&] {
+        while (!stopRequested) {
+            try {
+                ScopedSpan span("refresh");
+                if (!processLeagues(db, pool, http, options, false)) {
+                    std::cerr << "Refresh finished with errors" << std::endl;
+                }
+                publishSnapshot();
+            } catch (std::exception &e) {
+                std::cerr << "Refresh failed: " << e.what() << std::endl;
+            }
+            std::unique_lock lock(mutex);
+            wake.wait_for(lock, options.refreshInterval, [] { return stopRequested.load(); });
+        }
+    });
 
-    if (parts1.size() != parts2.size()) {
-        const auto &shorter = parts1.size() < parts2.size() ? parts1 : parts2;
-        const auto &longer = parts1.size() < parts2.size() ? parts2 : parts1;
-        return std::ranges::all_of(shorter, [&longer](const std::string &part) {
-            return std::ranges::find(longer, part) != longer.end();
-        });
+    bool listening = server.run(stopRequested);
+    {
+        std::lock_guard lock(mutex);
+        stopRequested = true;
     }
-
-    return false;
+    wake.notify_all();
+    refresher.join();
+    return listening ? 0 : 1;
 }
 
-void fetchDraftInformation(int year) {
-    std::string url = "https://en.wikipedia.org/wiki/" + std::to_string(year) + "_NFL_draft";
-    std::string html = makeHttpRequest(url);
-
-
-    htmlDocPtr doc = htmlReadMemory(html.c_str(), html.length(), url.c_str(), nullptr,
-                                    HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
-    if (doc == nullptr) {
-        std::cerr << "Failed to parse HTML for " << year << std::endl;
-        return;
+// Given league IDs on the command line this runs unattended (batch mode): the players dump and the draft pages are
+// processed once and shared, and each league only adds its own users, rosters and processed_players rows.
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        return 2;
     }
-
-
-    xmlXPathContextPtr context = xmlXPathNewContext(doc);
-    if (context == nullptr) {
-        std::cerr << "Failed to create XPath context" << std::endl;
-        xmlFreeDoc(doc);
-        return;
+    bool interactive = options.leagueIds.empty();
+    if (!options.metricsPath.empty() || !options.tracePath.empty()) {
+        metrics.enable();
     }
-
-
-    xmlXPathObjectPtr result =
-            xmlXPathEvalExpression(BAD_CAST "//table[contains(@class, 'wikitable') and contains(@class, 'sortable') "
-                                            "and contains(@class, 'plainrowheaders')]",
-                                   context);
-    if (result == nullptr) {
-        std::cerr << "XPath query failed" << std::endl;
-        xmlXPathFreeContext(context);
-        xmlFreeDoc(doc);
-        return;
+    if (options.reportFromSnapshot) {
+        int status = reportFromSnapshot(options);
+        writeMetrics(options);
+        return status;
     }
-
-    xmlNodeSetPtr tables = result->nodesetval;
-
-
-    if (tables->nodeNr == 0) {
-
-        xmlXPathFreeObject(result);
-        xmlXPathFreeContext(context);
-        xmlFreeDoc(doc);
-        return;
+    if (!options.exportPath.empty()) {
+        int status = 1;
+        try {
+            status = exportReport(options);
+        } catch (std::exception &e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+        }
+        writeMetrics(options);
+        return status;
     }
 
-    xmlNodePtr table = tables->nodeTab[0];
-
-
-    xmlNodePtr tbody = table->children;
-    while (tbody && xmlStrcmp(tbody->name, (const xmlChar *) "tbody") != 0) {
-        tbody = tbody->next;
+    if (!options.socketPath.empty() && interactive) {
+        std::cerr << "--serve needs --league or --leagues-file." << std::endl;
+        return 2;
     }
 
-    if (tbody) {
-        xmlNodePtr row = tbody->children;
-        int rowCount = 0;
-        while (row) {
-            if (row->type == XML_ELEMENT_NODE && xmlStrcmp(row->name, (const xmlChar *) "tr") == 0) {
-                rowCount++;
-                std::vector<std::string> rowData;
-                xmlNodePtr cell = row->children;
-                while (cell) {
-                    if (cell->type == XML_ELEMENT_NODE && (xmlStrcmp(cell->name, (const xmlChar *) "td") == 0 ||
-                                                           xmlStrcmp(cell->name, (const xmlChar *) "th") == 0)) {
-                        if (xmlChar *content = xmlNodeGetContent(cell)) {
-                            std::string cellContent = (char *) content;
-                            std::erase(cellContent, '\n');
-                            cellContent = std::regex_replace(cellContent, std::regex("\\s+"), " ");
-                            cellContent = std::regex_replace(cellContent, std::regex("^ +| +$"), "");
-                            rowData.push_back(cellContent);
-                            xmlFree(content);
-                        } else {
-                            rowData.emplace_back("");
-                        }
-                    }
-                    cell = cell->next;
-                }
+    try {
+        SQLite::Database db(options.inMemory ? ":memory:" : options.databasePath,
+                            SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+        if (options.inMemory) {
+            loadDatabase(db, options.databasePath);
+        }
+        configureDatabase(db);
 
+        HttpCache cache("http_cache");
+        cache.setTtl("https://api.sleeper.app/", std::chrono::minutes(5));
+        cache.setTtl("https://en.wikipedia.org/", std::chrono::hours(24));
 
-                for (size_t i = 0; i < rowData.size(); ++i) {
-                }
+        HttpClient http;
+        http.setCache(&cache);
 
-                if (rowData.size() >= 5) {
-                    try {
-                        int round = std::stoi(rowData[1]);
-                        int pick = std::stoi(rowData[2]);
-                        std::string team = rowData[3];
-                        std::string player_name = cleanName(rowData[4]);
-
-                        player_name = std::regex_replace(player_name, std::regex("<[^>]*>"), "");
-                        player_name = std::regex_replace(player_name, std::regex("&nbsp;"), " ");
-                        player_name = std::regex_replace(player_name, std::regex("[†‡*]"), "");
-                        player_name = std::regex_replace(player_name, std::regex("^ +| +$"), "");
-
-
-                        bool playerFound = false;
-                        for (auto &player: players) {
-                            if (namesMatch(player.full_name, player_name)) {
-                                player.draft_round = round;
-                                player.draft_pick = pick;
-                                player.draft_team = team;
-                                player.draft_year = year;
-                                player.is_drafted = true;
-                                playerFound = true;
-
-                                break;
-                            }
-                        }
-                        if (!playerFound) {
-                        }
-                    } catch (const std::exception &e) {
-                    }
-                } else {
-                }
+        HttpArchiveWriter recorder;
+        HttpArchive archive;
+        if (!options.recordPath.empty()) {
+            if (!recorder.open(options.recordPath)) {
+                return 1;
             }
-            row = row->next;
+            http.setRecorder(&recorder);
         }
-
-    } else {
-    }
-
-    xmlXPathFreeObject(result);
-    xmlXPathFreeContext(context);
-    xmlFreeDoc(doc);
-}
-
-
-void createProcessedPlayersTable(SQLite::Database &db) {
-    db.exec("CREATE TABLE IF NOT EXISTS processed_players ("
-            "id TEXT PRIMARY KEY, "
-            "full_name TEXT, "
-            "position TEXT, "
-            "nfl_team TEXT, "
-            "fantasy_team TEXT, "
-            "years_exp INTEGER, "
-            "draft_year INTEGER, "
-            "draft_round INTEGER, "
-            "draft_pick INTEGER, "
-            "draft_team TEXT)");
-}
-
-void storeProcessedPlayers(SQLite::Database &db) {
-    SQLite::Transaction transaction(db);
-
-    try {
-        SQLite::Statement query(db, "INSERT OR REPLACE INTO processed_players "
-                                    "(id, full_name, position, nfl_team, fantasy_team, years_exp, "
-                                    "draft_year, draft_round, draft_pick, draft_team) "
-                                    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-
-        int stored_count = 0;
-        for (const auto &player: players) {
-            if (player.is_drafted) {
-                query.bind(1, player.id);
-                query.bind(2, player.full_name);
-                query.bind(3, player.position);
-                query.bind(4, player.nfl_team);
-                query.bind(5, player.fantasy_team);
-                query.bind(6, player.years_exp);
-                query.bind(7, player.draft_year);
-                query.bind(8, player.draft_round);
-                query.bind(9, player.draft_pick);
-                query.bind(10, player.draft_team);
-                query.exec();
-                query.reset();
-                stored_count++;
+        if (!options.replayPath.empty()) {
+            if (!archive.open(options.replayPath)) {
+                return 1;
             }
+            http.setReplay(&archive, options.replayTiming);
         }
 
-        transaction.commit();
-        std::cout << "Successfully stored " << stored_count << " drafted players in the database." << std::endl;
-    } catch (std::exception &e) {
-        std::cerr << "Error while storing processed players: " << e.what() << std::endl;
-    }
-}
-
+        // Network, HTML parsing and name matching run here; SQLite writes stay on this thread
+        ThreadPool pool(4);
 
-void displayRecentHighDraftPlayers(const SQLite::Database &db) {
-    int currentYear = getCurrentYear();
-    int threeYearsAgo = currentYear - 2; // To get the last 3 years
+        if (!options.socketPath.empty()) {
+            int status = serve(options, db, pool, http);
+            writeMetrics(options);
+            return status;
+        }
 
-    std::cout << "\n========== High Draft Picks (Last 3 Drafts) ==========\n";
+        if (interactive) {
+            std::string league_id;
+            std::cout << "Enter your Sleeper league ID: ";
+            std::cin >> league_id;
+            addLeague(options, league_id);
 
-    std::string query = "SELECT * FROM processed_players "
-                        "WHERE draft_round <= 3 "
-                        "AND draft_year >= ? "
-                        "ORDER BY draft_year DESC, draft_pick ASC";
+            std::cout << "Do you want to update the player database from Sleeper? (Y/N): ";
+            std::string response;
+            std::cin >> response;
+            options.refreshPlayers = response == "Y" || response == "y";
+        }
+        if (options.leagueIds.empty()) {
+            std::cerr << "No league ID given." << std::endl;
+            return 1;
+        }
 
-    try {
-        SQLite::Statement stmt(db, query);
-        stmt.bind(1, threeYearsAgo);
-
-        int prevYear = 0;
-        while (stmt.executeStep()) {
-            int year = stmt.getColumn("draft_year").getInt();
-            if (year != prevYear) {
-                if (prevYear != 0)
-                    std::cout << std::string(100, '-') << "\n";
-                std::cout << "\nDraft Year: " << year << "\n";
-                std::cout << std::string(100, '-') << "\n";
-                std::cout << std::left << std::setw(30) << "Player" << std::setw(5) << "Pos" << std::setw(15)
-                          << "NFL Team" << std::setw(10) << "Round" << std::setw(5) << "Pick" << std::setw(25) << "Fantasy Team" << "\n";
-                std::cout << std::string(100, '-') << "\n";
-                prevYear = year;
-            }
+        bool succeeded = processLeagues(db, pool, http, options, interactive);
+        if (!options.recordPath.empty() && succeeded && recorder.close()) {
+            std::cout << "Recorded " << recorder.size() << " HTTP responses to " << options.recordPath << std::endl;
+        }
+        writeMetrics(options);
 
-            std::string fantasyTeam = stmt.getColumn("fantasy_team").getText();
-            if (fantasyTeam == "Unrostered") {
-                fantasyTeam = "UNROSTERED";
-            }
 
-            std::cout << std::left << std::setw(30) << stmt.getColumn("full_name").getText()
-                      << std::setw(5) << stmt.getColumn("position").getText()
-                      << std::setw(15) << stmt.getColumn("nfl_team").getText()
-                      << std::setw(10) << stmt.getColumn("draft_round").getInt()
-                      << std::setw(5) << stmt.getColumn("draft_pick").getInt()
-                      << std::setw(25) << fantasyTeam << "\n";
+        if (interactive) {
+            waitForEnter();
         }
-        std::cout << std::string(100, '=') << "\n";
+        if (!succeeded) {
+            return 1;
+        }
+
     } catch (std::exception &e) {
-        std::cerr << "Error while querying recent high draft players: " << e.what() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+        writeMetrics(options);
+        if (interactive) {
+            waitForEnter();
+        }
+        return 1;
     }
+
+    return 0;
 }
@@ -0,0 +1,144 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sys/resource.h>
+
+
+Metrics metrics;
+
+static int64_t micros(Metrics::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+static bool writeJsonFile(const std::filesystem::path &path, const nlohmann::json &document) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!(out << document.dump(2) << '\n')) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Metrics::enable() {
+    std::lock_guard lock(mutex);
+    enabled = true;
+    origin = Clock::now();
+}
+
+void Metrics::count(const std::string &name, int64_t delta) {
+    if (!enabled) {
+        return;
+    }
+    std::lock_guard lock(mutex);
+    counters[name] += delta;
+}
+
+void Metrics::span(const std::string &name, const std::string &category, Clock::time_point start,
+                   Clock::time_point end, nlohmann::json args) {
+    if (!enabled) {
+        return;
+    }
+    std::lock_guard lock(mutex);
+    spans.push_back({name, category, micros(start - origin), micros(end - start),
+                     threadNumber(std::this_thread::get_id()), std::move(args)});
+}
+
+// Small stable numbers read better in a trace viewer than std::thread::id hashes
+int Metrics::threadNumber(std::thread::id id) {
+    auto [it, inserted] = threads.try_emplace(id, (int) threads.size() + 1);
+    return it->second;
+}
+
+nlohmann::json Metrics::report() const {
+    std::lock_guard lock(mutex);
+
+    struct StageTotals {
+        int count = 0;
+        int64_t totalMicros = 0;
+        int64_t maxMicros = 0;
+    };
+    std::map<std::string, StageTotals> totals;
+    for (const auto &span: spans) {
+        StageTotals &stage = totals[span.name];
+        stage.count++;
+        stage.totalMicros += span.durationMicros;
+        stage.maxMicros = std::max(stage.maxMicros, span.durationMicros);
+    }
+
+    nlohmann::json stages = nlohmann::json::object();
+    for (const auto &[name, stage]: totals) {
+        stages[name] = {{"count", stage.count},
+                        {"total_ms", (double) stage.totalMicros / 1000.0},
+                        {"max_ms", (double) stage.maxMicros / 1000.0}};
+    }
+
+    nlohmann::json spanList = nlohmann::json::array();
+    for (const auto &span: spans) {
+        nlohmann::json entry = {{"name", span.name},
+                                {"category", span.category},
+                                {"start_ms", (double) span.startMicros / 1000.0},
+                                {"duration_ms", (double) span.durationMicros / 1000.0},
+                                {"thread", span.thread}};
+        if (!span.args.is_null()) {
+            entry["args"] = span.args;
+        }
+        spanList.push_back(std::move(entry));
+    }
+
+    return {{"wall_ms", (double) micros(Clock::now() - origin) / 1000.0},
+            {"peak_rss_kb", peakRssKb()},
+            {"counters", counters},
+            {"stages", stages},
+            {"spans", spanList}};
+}
+
+nlohmann::json Metrics::chromeTrace() const {
+    std::lock_guard lock(mutex);
+
+    nlohmann::json events = nlohmann::json::array();
+    for (const auto &span: spans) {
+        nlohmann::json event = {{"name", span.name}, {"cat", span.category}, {"ph", "X"},
+                                {"ts", span.startMicros}, {"dur", span.durationMicros}, {"pid", 1},
+                                {"tid", span.thread}};
+        if (!span.args.is_null()) {
+            event["args"] = span.args;
+        }
+        events.push_back(std::move(event));
+    }
+    for (const auto &[name, value]: counters) {
+        events.push_back({{"name", name}, {"ph", "C"}, {"ts", micros(Clock::now() - origin)}, {"pid", 1},
+                          {"args", {{"value", value}}}});
+    }
+    return {{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+}
+
+bool Metrics::writeReport(const std::filesystem::path &path) const {
+    return writeJsonFile(path, report());
+}
+
+bool Metrics::writeChromeTrace(const std::filesystem::path &path) const {
+    return writeJsonFile(path, chromeTrace());
+}
+
+ScopedSpan::ScopedSpan(std::string name, std::string category) :
+        name(std::move(name)), category(std::move(category)), start(Metrics::Clock::now()) {}
+
+ScopedSpan::~ScopedSpan() {
+    if (metrics.isEnabled()) {
+        metrics.span(name, category, start, Metrics::Clock::now(), std::move(args));
+    }
+}
+
+int64_t peakRssKb() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS, KiB elsewhere
+#else
+    return usage.ru_maxrss;
+#endif
+}
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Process-wide timings and counters. Everything is a no-op until enable() is called, but names and args are
+// built before that check, so call sites that format them per page or per year test isEnabled() first. Safe to
+// use from the pipeline threads.
+class Metrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void enable();
+    bool isEnabled() const { return enabled; }
+
+    void count(const std::string &name, int64_t delta = 1);
+    void span(const std::string &name, const std::string &category, Clock::time_point start, Clock::time_point end,
+              nlohmann::json args = nullptr);
+
+    // Counters, per-stage totals, every span and the peak RSS as one JSON document
+    nlohmann::json report() const;
+    // The spans as a Chrome trace (chrome://tracing, Perfetto), one track per thread
+    nlohmann::json chromeTrace() const;
+
+    bool writeReport(const std::filesystem::path &path) const;
+    bool writeChromeTrace(const std::filesystem::path &path) const;
+
+private:
+    struct Span {
+        std::string name;
+        std::string category;
+        int64_t startMicros;
+        int64_t durationMicros;
+        int thread;
+        nlohmann::json args;
+    };
+
+    int threadNumber(std::thread::id id);
+
+    mutable std::mutex mutex;
+    std::atomic<bool> enabled = false;
+    Clock::time_point origin = Clock::now();
+    std::vector<Span> spans;
+    std::map<std::string, int64_t> counters;
+    std::map<std::thread::id, int> threads;
+};
+
+extern Metrics metrics;
+
+// Times the enclosing scope as one span; args can be filled in before the scope ends
+class ScopedSpan {
+public:
+    explicit ScopedSpan(std::string name, std::string category = "stage");
+    ~ScopedSpan();
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+    nlohmann::json args;
+
+private:
+    std::string name;
+    std::string category;
+    Metrics::Clock::time_point start;
+};
+
+// Peak resident set size of this process in KiB, 0 where it cannot be read
+int64_t peakRssKb();
+
+#endif // METRICS_H
@@ -0,0 +1,372 @@
+#include "name_matching.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstdlib>
+
+#include "text_normalize.h"
+
+
+std::string cleanName(const std::string &name) {
+    std::string cleaned;
+    normalizeName(name, cleaned);
+    return cleaned;
+}
+
+// Cleaned names are already trimmed with single spaces between tokens
+static std::vector<std::string> tokenize(const std::string &cleaned) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start < cleaned.size()) {
+        size_t end = cleaned.find(' ', start);
+        if (end == std::string::npos)
+            end = cleaned.size();
+        parts.emplace_back(cleaned, start, end - start);
+        start = end + 1;
+    }
+    return parts;
+}
+
+// The partial-name rule of namesMatch: with differing token counts, every token of the shorter name
+// must appear in the longer one
+static bool tokensMatch(const std::vector<std::string> &parts1, const std::vector<std::string> &parts2) {
+    if (parts1.size() == parts2.size()) {
+        return false;
+    }
+    const auto &shorter = parts1.size() < parts2.size() ? parts1 : parts2;
+    const auto &longer = parts1.size() < parts2.size() ? parts2 : parts1;
+    return std::ranges::all_of(shorter, [&longer](const std::string &part) {
+        return std::ranges::find(longer, part) != longer.end();
+    });
+}
+
+bool namesMatch(const std::string &name1, const std::string &name2) {
+    std::string clean1 = cleanName(name1);
+    std::string clean2 = cleanName(name2);
+
+
+    if (clean1 == clean2)
+        return true;
+
+
+    return tokensMatch(tokenize(clean1), tokenize(clean2));
+}
+
+void NameIndex::build(const std::vector<std::string> &names) {
+    std::vector<std::string> cleaned;
+    cleaned.reserve(names.size());
+    for (const auto &name: names) {
+        cleaned.push_back(cleanName(name));
+    }
+    buildNormalized(cleaned);
+}
+
+void NameIndex::buildNormalized(const std::vector<std::string> &cleanedNames) {
+    tokenLists.clear();
+    exact.clear();
+    postings.clear();
+    firstEmpty = -1;
+    tokenLists.reserve(cleanedNames.size());
+
+    for (size_t i = 0; i < cleanedNames.size(); ++i) {
+        int index = (int) i;
+        const std::string &cleaned = cleanedNames[i];
+        std::vector<std::string> tokens = tokenize(cleaned);
+
+        exact.try_emplace(cleaned, index);
+        if (tokens.empty() && firstEmpty < 0) {
+            firstEmpty = index;
+        }
+        for (size_t t = 0; t < tokens.size(); ++t) {
+            // Post each distinct token once per name
+            if (std::find(tokens.begin(), tokens.begin() + (long) t, tokens[t]) == tokens.begin() + (long) t) {
+                postings[tokens[t]].push_back(index);
+            }
+        }
+        tokenLists.push_back(std::move(tokens));
+    }
+}
+
+int NameIndex::findFirst(const std::string &name) const {
+    if (tokenLists.empty()) {
+        return -1;
+    }
+
+    std::string cleaned = cleanName(name);
+    std::vector<std::string> tokens = tokenize(cleaned);
+
+    // A query without tokens is a subset of every non-empty name and equal to every empty one
+    if (tokens.empty()) {
+        return 0;
+    }
+
+    int best = firstEmpty >= 0 ? firstEmpty : INT_MAX;
+    if (auto it = exact.find(cleaned); it != exact.end()) {
+        best = std::min(best, it->second);
+    }
+
+    // Any other match must share at least one token with the query
+    for (const auto &token: tokens) {
+        auto it = postings.find(token);
+        if (it == postings.end()) {
+            continue;
+        }
+        for (int index: it->second) {
+            if (index >= best) {
+                break;
+            }
+            if (tokensMatch(tokenLists[index], tokens)) {
+                best = index;
+                break;
+            }
+        }
+    }
+
+    return best == INT_MAX ? -1 : best;
+}
+
+static constexpr int groupCount = 12;
+static constexpr int maxYearsExp = 31; // higher years_exp share the last bucket
+
+int positionGroup(std::string_view position) {
+    static const std::unordered_map<std::string_view, int> groups = {
+            {"QB", 1},  {"RB", 2},  {"FB", 2},  {"HB", 2},   {"WR", 3},  {"TE", 4},  {"OL", 5}, {"OT", 5},
+            {"T", 5},   {"OG", 5},  {"G", 5},   {"C", 5},    {"DL", 6},  {"DE", 6},  {"DT", 6}, {"NT", 6},
+            {"LB", 7},  {"OLB", 7}, {"ILB", 7}, {"MLB", 7},  {"DB", 8},  {"CB", 8},  {"S", 8},  {"FS", 8},
+            {"SS", 8},  {"K", 9},   {"PK", 9},  {"P", 10},   {"LS", 11},
+    };
+    auto it = groups.find(position);
+    return it == groups.end() ? 0 : it->second;
+}
+
+// Groups a drafted player may be listed under later: edge rushers drafted as DE often play LB, safeties LB, and
+// fullbacks end up at tight end. Unknown positions (group 0) can be anything.
+static uint32_t compatibleGroups(int group) {
+    switch (group) {
+        case 0: return (1u << groupCount) - 1;
+        case 4: return 1u << 0 | 1u << 4 | 1u << 2;
+        case 6: return 1u << 0 | 1u << 6 | 1u << 7;
+        case 7: return 1u << 0 | 1u << 7 | 1u << 6 | 1u << 8;
+        case 8: return 1u << 0 | 1u << 8 | 1u << 7;
+        default: return 1u << 0 | 1u << group;
+    }
+}
+
+static bool isSuffix(std::string_view token) {
+    return token == "jr" || token == "sr" || token == "ii" || token == "iii" || token == "iv" || token == "v";
+}
+
+// Letters, digits and single spaces only: "d.j. moore" and "dj moore" share a key, hyphens separate tokens and
+// generational suffixes are dropped. Non-ASCII letters that normalizeName could not fold are kept as they are.
+size_t FuzzyNameMatcher::makeKey(std::string_view cleaned, Key &key) {
+    size_t length = 0;
+    size_t tokenStart = 0;
+    auto endToken = [&] {
+        if (isSuffix(std::string_view(key.data() + tokenStart, length - tokenStart)) && tokenStart > 0) {
+            length = tokenStart;
+        }
+        if (length > 0 && key[length - 1] != ' ' && length < keyWidth) {
+            key[length++] = ' ';
+        }
+        tokenStart = length;
+    };
+    for (size_t i = 0; i < cleaned.size(); ++i) {
+        char c = cleaned[i];
+        if (cleaned.substr(i, 3) == "\u2019" || cleaned.substr(i, 3) == "\u2018") {
+            i += 2; // curly apostrophes, like straight ones
+        } else if (c == ' ' || c == '-') {
+            endToken();
+        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (unsigned char) c >= 0x80) {
+            if (length < keyWidth) {
+                key[length++] = c;
+            }
+        }
+    }
+    endToken();
+    while (length > 0 && key[length - 1] == ' ') {
+        length--;
+    }
+    return length;
+}
+
+static size_t surnameStart(std::string_view key) {
+    size_t space = key.rfind(' ');
+    return space == std::string_view::npos ? 0 : space + 1;
+}
+
+void FuzzyNameMatcher::build(const std::vector<std::string> &cleanedNames, const std::vector<std::string> &positions,
+                             const std::vector<int> &yearsExp, int currentSeason) {
+    season = currentSeason;
+    keys.clear();
+    lengths.clear();
+    surnameStarts.clear();
+    slotPlayers.clear();
+    buckets.assign((size_t) groupCount * (maxYearsExp + 1), {0, 0});
+
+    // Counting sort of the players into buckets, so every bucket is one contiguous run of slots
+    std::vector<int> bucketOf(cleanedNames.size(), -1);
+    std::vector<uint32_t> counts(buckets.size() + 1, 0);
+    for (size_t i = 0; i < cleanedNames.size(); ++i) {
+        if (positions[i] == "DEF" || cleanedNames[i].empty()) {
+            continue; // team defenses are never drafted
+        }
+        bucketOf[i] = positionGroup(positions[i]) * (maxYearsExp + 1) + std::clamp(yearsExp[i], 0, maxYearsExp);
+        counts[(size_t) bucketOf[i] + 1]++;
+    }
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        counts[b + 1] += counts[b];
+        buckets[b] = {counts[b], counts[b + 1]};
+    }
+
+    keys.resize(counts.back());
+    lengths.resize(counts.back());
+    surnameStarts.resize(counts.back());
+    slotPlayers.resize(counts.back());
+    for (size_t i = 0; i < cleanedNames.size(); ++i) {
+        if (bucketOf[i] < 0) {
+            continue;
+        }
+        uint32_t slot = counts[(size_t) bucketOf[i]]++;
+        keys[slot].fill(' ');
+        lengths[slot] = (uint8_t) makeKey(cleanedNames[i], keys[slot]);
+        surnameStarts[slot] = (uint8_t) surnameStart(std::string_view(keys[slot].data(), lengths[slot]));
+        slotPlayers[slot] = (uint32_t) i;
+    }
+}
+
+const FuzzyNameMatcher::Bucket *FuzzyNameMatcher::bucket(int group, int yearsExp) const {
+    return &buckets[(size_t) group * (maxYearsExp + 1) + (size_t) yearsExp];
+}
+
+// Bit i of positions[c] is set when query[i] == c
+using CharPositions = std::array<uint32_t, 256>;
+
+static void findPositions(std::string_view query, CharPositions &positions) {
+    positions.fill(0);
+    for (size_t i = 0; i < query.size(); ++i) {
+        positions[(unsigned char) query[i]] |= 1u << i;
+    }
+}
+
+// Jaro-Winkler similarity between the query, described by the positions of each byte in it, and one key. Matched
+// characters are tracked as bitmasks over the (at most 32) positions, so there are no buffers to allocate.
+static double jaroWinkler(const CharPositions &queryPositions, std::string_view query, std::string_view key) {
+    if (query.empty() || key.empty()) {
+        return query.empty() && key.empty() ? 1 : 0;
+    }
+    int queryLength = (int) query.size();
+    int keyLength = (int) key.size();
+    int window = std::max(0, std::max(queryLength, keyLength) / 2 - 1);
+
+    uint32_t queryMatched = 0;
+    uint32_t keyMatched = 0;
+    int matches = 0;
+    for (int j = 0; j < keyLength; ++j) {
+        int lo = std::max(0, j - window);
+        int hi = std::min(queryLength - 1, j + window);
+        if (lo > hi) {
+            continue;
+        }
+        uint32_t range = (hi - lo == 31 ? ~0u : (1u << (hi - lo + 1)) - 1) << lo;
+        uint32_t available = queryPositions[(unsigned char) key[j]] & range & ~queryMatched;
+        if (available != 0) {
+            queryMatched |= available & -available;
+            keyMatched |= 1u << j;
+            matches++;
+        }
+    }
+    if (matches == 0) {
+        return 0;
+    }
+
+    // Matched characters in order on both sides; each position where they differ is half a transposition
+    int halfTranspositions = 0;
+    while (queryMatched != 0) {
+        int q = std::countr_zero(queryMatched);
+        int k = std::countr_zero(keyMatched);
+        halfTranspositions += query[q] != key[k];
+        queryMatched &= queryMatched - 1;
+        keyMatched &= keyMatched - 1;
+    }
+
+    double m = matches;
+    double jaro = (m / queryLength + m / keyLength + (m - halfTranspositions / 2.0) / m) / 3;
+    int prefix = 0;
+    while (prefix < 4 && prefix < queryLength && prefix < keyLength && query[prefix] == key[prefix]) {
+        prefix++;
+    }
+    return jaro + prefix * 0.1 * (1 - jaro);
+}
+
+FuzzyMatch FuzzyNameMatcher::find(const std::string &name, std::string_view position, int draftYear,
+                                  const std::vector<bool> &taken) const {
+    FuzzyMatch result;
+    Key query;
+    size_t queryLength = makeKey(cleanName(name), query);
+    if (queryLength == 0 || slotPlayers.empty()) {
+        return result;
+    }
+    std::string_view queryKey(query.data(), queryLength);
+    size_t split = surnameStart(queryKey);
+    std::string_view querySurname = queryKey.substr(split);
+    std::string_view queryGiven = queryKey.substr(0, split == 0 ? 0 : split - 1);
+
+    CharPositions surnamePositions;
+    CharPositions givenPositions;
+    findPositions(querySurname, surnamePositions);
+    findPositions(queryGiven, givenPositions);
+
+    // A player drafted in draftYear has about season - draftYear years of experience; one who missed seasons
+    // can be up to two behind
+    int expected = season - draftYear;
+    if (expected + 1 < 0) {
+        return result;
+    }
+    int lowestYearsExp = std::clamp(expected - 2, 0, maxYearsExp);
+    int highestYearsExp = std::clamp(expected + 1, 0, maxYearsExp);
+
+    uint32_t groups = compatibleGroups(positionGroup(position));
+    for (int group = 0; group < groupCount; ++group) {
+        if ((groups & (1u << group)) == 0) {
+            continue;
+        }
+        for (int yearsExp = lowestYearsExp; yearsExp <= highestYearsExp; ++yearsExp) {
+            const Bucket *slots = bucket(group, yearsExp);
+            for (uint32_t slot = slots->begin; slot < slots->end; ++slot) {
+                std::string_view key(keys[slot].data(), lengths[slot]);
+                size_t keySplit = surnameStarts[slot];
+                double surname = jaroWinkler(surnamePositions, querySurname, key.substr(keySplit));
+                if (surname < surnameThreshold) {
+                    continue;
+                }
+                uint32_t player = slotPlayers[slot];
+                if (!taken.empty() && taken[player]) {
+                    continue;
+                }
+
+                std::string_view keyGiven = key.substr(0, keySplit == 0 ? 0 : keySplit - 1);
+                double given = jaroWinkler(givenPositions, queryGiven, keyGiven);
+                if (given < givenThreshold) {
+                    continue;
+                }
+                double score = 0.6 * surname + 0.4 * given;
+                if (score > result.score || (score == result.score && (int) player < result.index)) {
+                    result.runnerUp = result.index;
+                    result.runnerUpScore = result.score;
+                    result.index = (int) player;
+                    result.score = score;
+                } else if (score > result.runnerUpScore) {
+                    result.runnerUp = (int) player;
+                    result.runnerUpScore = score;
+                }
+            }
+        }
+    }
+
+    if (result.score >= threshold) {
+        result.ambiguous = result.runnerUp >= 0 && result.runnerUpScore > result.score - ambiguityMargin;
+        result.accepted = !result.ambiguous;
+    }
+    return result;
+}
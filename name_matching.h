@@ -0,0 +1,92 @@
+#ifndef NAME_MATCHING_H
+#define NAME_MATCHING_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+std::string cleanName(const std::string &name);
+bool namesMatch(const std::string &name1, const std::string &name2);
+
+// Pre-normalized lookup structure over a fixed list of names. findFirst() returns the same index as scanning
+// the list in order and stopping at the first namesMatch(), but only checks names sharing a token with the query.
+class NameIndex {
+public:
+    void build(const std::vector<std::string> &names);
+    // Same as build() for names that already went through cleanName()
+    void buildNormalized(const std::vector<std::string> &cleanedNames);
+
+    // Index of the first name that namesMatch() accepts, or -1 when there is none
+    int findFirst(const std::string &name) const;
+
+    size_t size() const { return tokenLists.size(); }
+
+private:
+    std::vector<std::vector<std::string>> tokenLists;
+    std::unordered_map<std::string, int> exact;              // cleaned name -> first index
+    std::unordered_map<std::string, std::vector<int>> postings; // token -> ascending indices
+    int firstEmpty = -1; // an empty cleaned name matches everything
+};
+
+// Position group shared by draft tables ("OT", "OLB", "FS") and Sleeper ("OL", "LB", "DB"), so the two can be
+// compared. 0 when the position is empty or unknown.
+int positionGroup(std::string_view position);
+
+struct FuzzyMatch {
+    int index = -1; // best candidate, -1 when no candidate was scored
+    double score = 0;
+    int runnerUp = -1; // best candidate after index
+    double runnerUpScore = 0;
+    bool accepted = false;  // score reached the threshold and the runner-up is clearly behind
+    bool ambiguous = false; // score reached the threshold but the runner-up is too close to tell apart
+};
+
+// Second tier for draft picks the NameIndex rejects: "Gabe Davis" for "Gabriel Davis", "D.J. Moore" for
+// "DJ Moore", "Tank Walker III" for "Tank Walker". Names are reduced to letters, digits and spaces without
+// generational suffixes and packed into fixed-width slots, grouped by position group and years of experience.
+// A query only scores the slots whose players could plausibly have been drafted that year at that position, with
+// a Jaro-Winkler kernel that works on bitmasks instead of allocating. Surnames and given names each have to pass
+// their own threshold, and the score weighs surnames above given names, where short forms differ most.
+class FuzzyNameMatcher {
+public:
+    static constexpr size_t keyWidth = 32;            // longer keys are truncated
+    static constexpr double surnameThreshold = 0.92;  // minimum surname similarity
+    static constexpr double givenThreshold = 0.85;    // minimum given-name similarity ("gabe" and "gabriel" score 0.9)
+    static constexpr double threshold = 0.9;          // minimum weighted similarity to accept
+    static constexpr double ambiguityMargin = 0.02;   // the runner-up must score at least this much lower
+
+    // Names are cleanName() output. season is the year whose years_exp values are given, used to work out which
+    // draft classes a player can belong to.
+    void build(const std::vector<std::string> &cleanedNames, const std::vector<std::string> &positions,
+               const std::vector<int> &yearsExp, int season);
+
+    // Best candidate for a pick; taken, when not empty, marks players already matched to another pick
+    FuzzyMatch find(const std::string &name, std::string_view position, int draftYear,
+                    const std::vector<bool> &taken = {}) const;
+
+    size_t size() const { return slotPlayers.size(); }
+
+private:
+    using Key = std::array<char, keyWidth>;
+
+    struct Bucket {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    static size_t makeKey(std::string_view cleaned, Key &key);
+    const Bucket *bucket(int group, int yearsExp) const;
+
+    std::vector<Key> keys; // slots ordered by bucket
+    std::vector<uint8_t> lengths;
+    std::vector<uint8_t> surnameStarts; // offset of the last token
+    std::vector<uint32_t> slotPlayers; // slot -> player index
+    std::vector<Bucket> buckets;       // group * (maxYearsExp + 1) + years_exp
+    int season = 0;
+};
+
+#endif // NAME_MATCHING_H
@@ -0,0 +1,100 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+// Multi-producer/multi-consumer queue between pipeline stages. push() blocks while the queue is full, which
+// gives back-pressure to faster upstream stages; pop() returns nullopt once the queue is closed and drained.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    bool push(T item) {
+        std::unique_lock lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    // Producers are done; consumers drain what is left and then see nullopt
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// Fixed set of worker threads running submitted stage functions. Long-running stages (network, parsing)
+// each hold a worker for their lifetime, so size the pool for the stages plus some short tasks.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads) : tasks(std::max<size_t>(1, threads) * 4) {
+        for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) {
+            workers.emplace_back([this] {
+                while (auto task = tasks.pop()) {
+                    (*task)();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        tasks.close();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template<typename F>
+    auto submit(F &&f) -> std::future<std::invoke_result_t<F>> {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        std::future<std::invoke_result_t<F>> result = task->get_future();
+        tasks.push([task] { (*task)(); });
+        return result;
+    }
+
+private:
+    BoundedQueue<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+};
+
+#endif // PIPELINE_H
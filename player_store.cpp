@@ -0,0 +1,114 @@
+#include "player_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "text_normalize.h"
+
+
+uint16_t StringPool::intern(std::string_view value) {
+    auto [it, inserted] = codes.try_emplace(std::string(value), (uint16_t) strings.size());
+    if (inserted) {
+        if (strings.size() > UINT16_MAX) {
+            codes.erase(it);
+            throw std::length_error("StringPool is full");
+        }
+        strings.emplace_back(value);
+    }
+    return it->second;
+}
+
+void StringPool::clear() {
+    strings.assign(1, std::string());
+    codes.clear();
+    codes.emplace(std::string(), 0);
+}
+
+void PlayerStore::clear() {
+    labels.clear();
+    for (auto *column: {&ids, &fullNames, &normalized}) {
+        column->clear();
+    }
+    for (auto *column: {&positionCodes, &nflTeamCodes, &fantasyTeamCodes, &draftPicks, &draftTeamCodes}) {
+        column->clear();
+    }
+    yearsExpColumn.clear();
+    draftYears.clear();
+    draftRounds.clear();
+}
+
+void PlayerStore::reserve(size_t count) {
+    for (auto *column: {&ids, &fullNames, &normalized}) {
+        column->reserve(count);
+    }
+    for (auto *column: {&positionCodes, &nflTeamCodes, &fantasyTeamCodes, &draftPicks, &draftTeamCodes}) {
+        column->reserve(count);
+    }
+    yearsExpColumn.reserve(count);
+    draftYears.reserve(count);
+    draftRounds.reserve(count);
+}
+
+size_t PlayerStore::add(std::string_view id, std::string_view fullName, std::string_view position,
+                        std::string_view nflTeam, int yearsExp) {
+    ids.emplace_back(id);
+    fullNames.emplace_back(fullName);
+    normalizeName(fullName, normalized.emplace_back());
+    positionCodes.push_back(labels.intern(position));
+    nflTeamCodes.push_back(labels.intern(nflTeam));
+    fantasyTeamCodes.push_back(0);
+    yearsExpColumn.push_back((int16_t) yearsExp);
+
+    draftYears.push_back(0);
+    draftRounds.push_back(0);
+    draftPicks.push_back(0);
+    draftTeamCodes.push_back(0);
+    return ids.size() - 1;
+}
+
+void PlayerStore::setDraft(size_t i, const DraftPick &pick) {
+    draftYears[i] = (int16_t) pick.year;
+    draftRounds[i] = (uint8_t) pick.round;
+    draftPicks[i] = (uint16_t) pick.pick;
+    draftTeamCodes[i] = labels.intern(pick.team);
+}
+
+std::vector<size_t> PlayerStore::draftedSince(int fromYear, int maxRound) const {
+    std::vector<size_t> selected;
+    for (size_t i = 0; i < draftYears.size(); ++i) {
+        if (draftYears[i] >= fromYear && draftRounds[i] <= maxRound && draftYears[i] != 0) {
+            selected.push_back(i);
+        }
+    }
+    std::ranges::sort(selected, [this](size_t a, size_t b) {
+        if (draftYears[a] != draftYears[b]) {
+            return draftYears[a] > draftYears[b];
+        }
+        return draftPicks[a] < draftPicks[b];
+    });
+    return selected;
+}
+
+void PlayerStore::clearDraft(size_t i) {
+    draftYears[i] = 0;
+    draftRounds[i] = 0;
+    draftPicks[i] = 0;
+    draftTeamCodes[i] = 0;
+}
+
+void PlayerStore::clearDrafts() {
+    std::ranges::fill(draftYears, 0);
+    std::ranges::fill(draftRounds, 0);
+    std::ranges::fill(draftPicks, 0);
+    std::ranges::fill(draftTeamCodes, 0);
+}
+
+int PlayerStore::oldestDraftYear(int currentYear) const {
+    int oldest = currentYear;
+    for (int16_t yearsExp: yearsExpColumn) {
+        if (yearsExp > 0) {
+            oldest = std::min(oldest, currentYear - yearsExp);
+        }
+    }
+    return oldest;
+}
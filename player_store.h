@@ -0,0 +1,85 @@
+#ifndef PLAYER_STORE_H
+#define PLAYER_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "draft_parser.h"
+
+
+// Interns repeated strings (positions, team names) into dense 16-bit codes in first-seen order. Code 0 is
+// always the empty string.
+class StringPool {
+public:
+    StringPool() { clear(); }
+
+    uint16_t intern(std::string_view value);
+    const std::string &operator[](uint16_t code) const { return strings[code]; }
+    size_t size() const { return strings.size(); }
+    void clear();
+
+private:
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint16_t> codes;
+};
+
+// The players of a run as parallel columns instead of one struct per player. Low-cardinality strings are
+// interned, so the loops over the working set (draft range, matching merge, processed_players, the report)
+// walk small dense arrays. Rows are addressed by their index, which is also the NameIndex position.
+class PlayerStore {
+public:
+    void clear();
+    void reserve(size_t count);
+
+    size_t add(std::string_view id, std::string_view fullName, std::string_view position, std::string_view nflTeam,
+               int yearsExp);
+    size_t size() const { return ids.size(); }
+
+    const std::string &id(size_t i) const { return ids[i]; }
+    const std::string &fullName(size_t i) const { return fullNames[i]; }
+    const std::vector<std::string> &normalizedNames() const { return normalized; }
+    const std::string &position(size_t i) const { return labels[positionCodes[i]]; }
+    const std::string &nflTeam(size_t i) const { return labels[nflTeamCodes[i]]; }
+    const std::string &fantasyTeam(size_t i) const { return labels[fantasyTeamCodes[i]]; }
+    int yearsExp(size_t i) const { return yearsExpColumn[i]; }
+
+    void setFantasyTeam(size_t i, std::string_view team) { fantasyTeamCodes[i] = labels.intern(team); }
+
+    // A player counts as drafted once a pick has been applied; later picks overwrite earlier ones
+    void setDraft(size_t i, const DraftPick &pick);
+    void clearDraft(size_t i);
+    void clearDrafts();
+    bool isDrafted(size_t i) const { return draftYears[i] != 0; }
+    int draftYear(size_t i) const { return draftYears[i]; }
+    int draftRound(size_t i) const { return draftRounds[i]; }
+    int draftPick(size_t i) const { return draftPicks[i]; }
+    const std::string &draftTeam(size_t i) const { return labels[draftTeamCodes[i]]; }
+
+    // Indices of drafted players from draft year fromYear on with round <= maxRound, newest draft first and
+    // in pick order within a year
+    std::vector<size_t> draftedSince(int fromYear, int maxRound) const;
+
+    // Oldest year anyone could have been drafted in, from years_exp; currentYear when nobody has experience
+    int oldestDraftYear(int currentYear) const;
+
+private:
+    StringPool labels;
+
+    std::vector<std::string> ids;
+    std::vector<std::string> fullNames;
+    std::vector<std::string> normalized;
+    std::vector<uint16_t> positionCodes;
+    std::vector<uint16_t> nflTeamCodes;
+    std::vector<uint16_t> fantasyTeamCodes;
+    std::vector<int16_t> yearsExpColumn;
+
+    std::vector<int16_t> draftYears; // 0 while undrafted
+    std::vector<uint8_t> draftRounds;
+    std::vector<uint16_t> draftPicks;
+    std::vector<uint16_t> draftTeamCodes;
+};
+
+#endif // PLAYER_STORE_H
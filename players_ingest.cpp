@@ -0,0 +1,477 @@
+#include "players_ingest.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sqlite3.h>
+#include <sstream>
+
+
+static std::string quoteIdentifier(const std::string &name) {
+    std::string quoted = "\"";
+    for (char c: name) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Declared type of a column created for a JSON value. Nested objects and arrays are stored as their JSON text.
+static const char *sqlTypeFor(const json &val) {
+    if (val.is_number_integer() || val.is_boolean()) {
+        return "INTEGER";
+    }
+    if (val.is_number_float()) {
+        return "REAL";
+    }
+    return "TEXT";
+}
+
+static void bindValue(SQLite::Statement &statement, int index, const json &val) {
+    if (val.is_string()) {
+        statement.bind(index, val.get_ref<const std::string &>());
+    } else if (val.is_number_integer()) {
+        statement.bind(index, val.get<int64_t>());
+    } else if (val.is_number_float()) {
+        statement.bind(index, val.get<double>());
+    } else if (val.is_boolean()) {
+        statement.bind(index, val.get<bool>() ? 1 : 0);
+    } else if (val.is_null()) {
+        statement.bind(index);
+    } else {
+        statement.bind(index, val.dump());
+    }
+}
+
+std::vector<std::string> loadPlayerColumns(SQLite::Database &db, const std::string &table) {
+    std::vector<std::string> columns;
+    SQLite::Statement query(db, "PRAGMA table_info(" + quoteIdentifier(table) + ")");
+    while (query.executeStep()) {
+        columns.emplace_back(query.getColumn(1).getText());
+    }
+    return columns;
+}
+
+void createPlayerIndexes(SQLite::Database &db) {
+    std::vector<std::string> columns = loadPlayerColumns(db);
+    auto has = [&columns](const char *name) { return std::ranges::find(columns, name) != columns.end(); };
+    if (!has("position") || !has("team") || !has("full_name") || !has("years_exp")) {
+        return;
+    }
+
+    // Covers the working-set filter of storePlayersInMemory, so loading it is a range scan per position
+    if (has("status")) {
+        db.exec("CREATE INDEX IF NOT EXISTS players_active_filter "
+                "ON players(position, status, team, id, full_name, years_exp)");
+    } else {
+        db.exec("CREATE INDEX IF NOT EXISTS players_position_filter "
+                "ON players(position, team, id, full_name, years_exp)");
+    }
+}
+
+PlayerIngestHandler::PlayerIngestHandler(SQLite::Database &db, IngestMode mode) : db(db), mode(mode) {
+    // Before version 1 every dynamic column was declared TEXT. Those tables are dropped so the refresh that is
+    // about to run rebuilds them with typed columns.
+    int version = db.execAndGet("PRAGMA user_version").getInt();
+    if (version < playersSchemaVersion) {
+        db.exec("DROP TABLE IF EXISTS players");
+        db.exec("DROP TABLE IF EXISTS player_hashes");
+        db.exec("PRAGMA user_version = " + std::to_string(playersSchemaVersion));
+    }
+
+    db.exec("CREATE TABLE IF NOT EXISTS players (id TEXT PRIMARY KEY)");
+    db.exec("CREATE TABLE IF NOT EXISTS player_hashes (id TEXT PRIMARY KEY, content_hash INTEGER NOT NULL)");
+    db.exec("CREATE TABLE IF NOT EXISTS players_generation (id INTEGER PRIMARY KEY CHECK (id = 1), "
+            "generation INTEGER NOT NULL)");
+
+    // Rows without a stored hash (written before hashes existed) get 0 and are rewritten once
+    SQLite::Statement query(db, "SELECT p.id, h.content_hash FROM players p "
+                                "LEFT JOIN player_hashes h ON h.id = p.id");
+    while (query.executeStep()) {
+        knownHashes.emplace(query.getColumn(0).getText(), (uint64_t) query.getColumn(1).getInt64());
+    }
+
+    if (this->mode == IngestMode::Incremental && knownHashes.empty()) {
+        this->mode = IngestMode::Bulk;
+    }
+    if (this->mode == IngestMode::Bulk) {
+        // No keys or indexes while loading; swapStagingTables() builds them once every row is in
+        table = "players_staging";
+        hashTable = "player_hashes_staging";
+        db.exec("DROP TABLE IF EXISTS players_staging");
+        db.exec("DROP TABLE IF EXISTS player_hashes_staging");
+        db.exec("CREATE TABLE players_staging (id TEXT)");
+        db.exec("CREATE TABLE player_hashes_staging (id TEXT, content_hash INTEGER NOT NULL)");
+    }
+
+    columns = loadPlayerColumns(db, table);
+    for (size_t i = 0; i < columns.size(); ++i) {
+        columnIndex.emplace(columns[i], (int) i);
+    }
+}
+
+int PlayerIngestHandler::columnFor(const std::string &name, const json &val) {
+    if (auto it = columnIndex.find(name); it != columnIndex.end()) {
+        return it->second;
+    }
+
+    db.exec("ALTER TABLE " + quoteIdentifier(table) + " ADD COLUMN " + quoteIdentifier(name) + " " + sqlTypeFor(val));
+    columns.push_back(name);
+    columnIndex.emplace(name, (int) columns.size() - 1);
+    insert.reset(); // the column list changed, re-prepare on the next flush
+    return (int) columns.size() - 1;
+}
+
+void PlayerIngestHandler::prepareWrite() {
+    std::stringstream ss;
+    ss << (mode == IngestMode::Full ? "INSERT OR REPLACE INTO " : "INSERT INTO ") << quoteIdentifier(table) << " (";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        ss << quoteIdentifier(columns[i]);
+        if (i < columns.size() - 1)
+            ss << ", ";
+    }
+    ss << ") VALUES (";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        ss << "?";
+        if (i < columns.size() - 1)
+            ss << ", ";
+    }
+    ss << ")";
+
+    // An upsert updates the row in place instead of deleting and re-inserting it
+    if (mode == IngestMode::Incremental) {
+        ss << " ON CONFLICT(id) DO UPDATE SET ";
+        bool first = true;
+        for (const auto &column: columns) {
+            if (column == "id")
+                continue;
+            if (!first)
+                ss << ", ";
+            ss << quoteIdentifier(column) << " = excluded." << quoteIdentifier(column);
+            first = false;
+        }
+        if (first) {
+            ss.str("");
+            ss << "INSERT OR IGNORE INTO players (id) VALUES (?)";
+        }
+    }
+    insert = std::make_unique<SQLite::Statement>(db, ss.str());
+
+    if (!storeHash) {
+        storeHash = std::make_unique<SQLite::Statement>(
+                db, "INSERT OR REPLACE INTO player_hashes (id, content_hash) VALUES (?, ?)");
+    }
+}
+
+// Multi-row INSERTs are capped by SQLite's bound-parameter limit
+size_t PlayerIngestHandler::batchRows() const {
+    auto variables = (size_t) sqlite3_limit(db.getHandle(), SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    return std::clamp<size_t>(variables / columns.size(), 1, 256);
+}
+
+void PlayerIngestHandler::prepareBatch(size_t rows) {
+    std::string row = "(";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        row += i == 0 ? "?" : ", ?";
+    }
+    row += ")";
+
+    std::stringstream ss;
+    ss << "INSERT INTO " << quoteIdentifier(table) << " (";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        ss << quoteIdentifier(columns[i]);
+        if (i < columns.size() - 1)
+            ss << ", ";
+    }
+    ss << ") VALUES ";
+    for (size_t i = 0; i < rows; ++i) {
+        ss << (i == 0 ? "" : ", ") << row;
+    }
+    insert = std::make_unique<SQLite::Statement>(db, ss.str());
+
+    std::stringstream hashes;
+    hashes << "INSERT INTO " << quoteIdentifier(hashTable) << " (id, content_hash) VALUES ";
+    for (size_t i = 0; i < rows; ++i) {
+        hashes << (i == 0 ? "(?, ?)" : ", (?, ?)");
+    }
+    storeHash = std::make_unique<SQLite::Statement>(db, hashes.str());
+    batchSize = rows;
+}
+
+void PlayerIngestHandler::writeBatch() {
+    int idColumn = columnIndex.at("id");
+    size_t written = 0;
+    while (written < pending.size()) {
+        size_t rows = std::min(batchRows(), pending.size() - written);
+        if (!insert || batchSize != rows) {
+            prepareBatch(rows);
+        }
+
+        insert->reset();
+        insert->clearBindings(); // columns missing from a player stay NULL
+        storeHash->reset();
+        for (size_t r = 0; r < rows; ++r) {
+            const PendingPlayer &player = pending[written + r];
+            int base = (int) (r * columns.size()) + 1;
+            insert->bind(base + idColumn, player.id);
+            for (const auto &[column, val]: player.record) {
+                bindValue(*insert, base + column, val);
+            }
+            storeHash->bind((int) r * 2 + 1, player.id);
+            storeHash->bind((int) r * 2 + 2, (int64_t) player.hash);
+        }
+        insert->exec();
+        storeHash->exec();
+        written += rows;
+    }
+    pending.clear();
+}
+
+// Runs inside the caller's transaction, so other connections keep reading the previous tables until it commits
+void PlayerIngestHandler::swapStagingTables() {
+    insert.reset();
+    storeHash.reset();
+    db.exec("DROP TABLE players");
+    db.exec("DROP TABLE player_hashes");
+    db.exec("ALTER TABLE players_staging RENAME TO players");
+    db.exec("ALTER TABLE player_hashes_staging RENAME TO player_hashes");
+    db.exec("CREATE UNIQUE INDEX players_id ON players(id)");
+    db.exec("CREATE UNIQUE INDEX player_hashes_id ON player_hashes(id)");
+    table = "players";
+    hashTable = "player_hashes";
+}
+
+// FNV-1a over the player's fields in column-name order, so key order in the feed does not matter
+uint64_t PlayerIngestHandler::recordHash() {
+    std::ranges::sort(record, [this](const auto &a, const auto &b) { return columns[a.first] < columns[b.first]; });
+
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](const std::string &bytes) {
+        for (unsigned char c: bytes) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        hash ^= 0x1f;
+        hash *= 1099511628211ULL;
+    };
+    // A null field hashes like a missing one: both leave the column NULL
+    for (const auto &[column, val]: record) {
+        if (val.is_null()) {
+            continue;
+        }
+        mix(columns[column]);
+        mix(val.dump());
+    }
+    // 0 is reserved for rows that have no stored hash yet
+    return hash == 0 ? 1 : hash;
+}
+
+void PlayerIngestHandler::flushRecord() {
+    uint64_t hash = recordHash();
+    auto known = knownHashes.find(playerId);
+    bool existed = known != knownHashes.end();
+    bool unchanged = existed && known->second == hash;
+    if (existed) {
+        knownHashes.erase(known);
+    }
+
+    if (mode == IngestMode::Incremental && unchanged) {
+        changes.unchanged++;
+        record.clear();
+        return;
+    }
+
+    if (mode == IngestMode::Bulk) {
+        if (unchanged) {
+            changes.unchanged++;
+        } else {
+            (existed ? changes.updated : changes.inserted).push_back(playerId);
+        }
+        pending.push_back({playerId, hash, std::move(record)});
+        record.clear();
+        rowCount++;
+        if (pending.size() >= batchRows()) {
+            writeBatch();
+        }
+        return;
+    }
+
+    if (!insert) {
+        prepareWrite();
+    }
+
+    insert->reset();
+    insert->clearBindings(); // columns missing from this player stay NULL
+    insert->bind(columnIndex.at("id") + 1, playerId);
+    for (const auto &[column, val]: record) {
+        bindValue(*insert, column + 1, val);
+    }
+    insert->exec();
+
+    storeHash->reset();
+    storeHash->bind(1, playerId);
+    storeHash->bind(2, (int64_t) hash);
+    storeHash->exec();
+
+    (existed ? changes.updated : changes.inserted).push_back(playerId);
+    record.clear();
+    rowCount++;
+}
+
+void PlayerIngestHandler::finish() {
+    if (mode == IngestMode::Bulk) {
+        writeBatch();
+        for (const auto &[id, hash]: knownHashes) {
+            changes.deleted.push_back(id);
+        }
+        knownHashes.clear();
+        swapStagingTables();
+        return;
+    }
+
+    if (mode != IngestMode::Incremental || knownHashes.empty()) {
+        return;
+    }
+
+    SQLite::Statement deletePlayer(db, "DELETE FROM players WHERE id = ?");
+    SQLite::Statement deleteHash(db, "DELETE FROM player_hashes WHERE id = ?");
+    for (const auto &[id, hash]: knownHashes) {
+        deletePlayer.bind(1, id);
+        deletePlayer.exec();
+        deletePlayer.reset();
+        deleteHash.bind(1, id);
+        deleteHash.exec();
+        deleteHash.reset();
+        changes.deleted.push_back(id);
+    }
+    knownHashes.clear();
+}
+
+bool PlayerIngestHandler::value(json val) {
+    if (depth == 2) {
+        // The map key is the player id; an "id" field inside the object would shadow it. A column is only
+        // created once a non-null value shows what type it should have.
+        if (fieldName == "id" || (val.is_null() && !columnIndex.contains(fieldName))) {
+            return true;
+        }
+        int column = columnFor(fieldName, val);
+        record.emplace_back(column, std::move(val));
+        return true;
+    }
+
+    if (depth > 2) {
+        json &parent = *nested.back();
+        if (parent.is_array()) {
+            parent.push_back(std::move(val));
+        } else {
+            parent[nestedKey] = std::move(val);
+        }
+        return true;
+    }
+
+    std::cerr << "JSON parse error in players data: expected an object of players" << std::endl;
+    return false;
+}
+
+bool PlayerIngestHandler::startContainer(json container) {
+    if (depth < 2) {
+        if (!container.is_object()) {
+            std::cerr << "JSON parse error in players data: expected an object of players" << std::endl;
+            return false;
+        }
+        depth++;
+        return true;
+    }
+
+    if (depth == 2) {
+        nestedRoot = std::move(container);
+        nested.push_back(&nestedRoot);
+    } else {
+        json &parent = *nested.back();
+        if (parent.is_array()) {
+            parent.push_back(std::move(container));
+            nested.push_back(&parent.back());
+        } else {
+            nested.push_back(&(parent[nestedKey] = std::move(container)));
+        }
+    }
+    depth++;
+    return true;
+}
+
+bool PlayerIngestHandler::endContainer() {
+    depth--;
+    if (depth >= 2) {
+        nested.pop_back();
+        if (nested.empty()) {
+            return value(std::move(nestedRoot));
+        }
+    } else if (depth == 1) {
+        flushRecord();
+    }
+    return true;
+}
+
+bool PlayerIngestHandler::null() { return value(nullptr); }
+
+bool PlayerIngestHandler::boolean(bool val) { return value(val); }
+
+bool PlayerIngestHandler::number_integer(number_integer_t val) { return value(val); }
+
+bool PlayerIngestHandler::number_unsigned(number_unsigned_t val) { return value(val); }
+
+bool PlayerIngestHandler::number_float(number_float_t val, const string_t &) { return value(val); }
+
+bool PlayerIngestHandler::string(string_t &val) { return value(std::move(val)); }
+
+bool PlayerIngestHandler::binary(binary_t &val) { return value(json::binary(std::move(val))); }
+
+bool PlayerIngestHandler::start_object(std::size_t) { return startContainer(json::object()); }
+
+bool PlayerIngestHandler::start_array(std::size_t) { return startContainer(json::array()); }
+
+bool PlayerIngestHandler::end_object() { return endContainer(); }
+
+bool PlayerIngestHandler::end_array() { return endContainer(); }
+
+bool PlayerIngestHandler::key(string_t &val) {
+    if (depth == 1) {
+        playerId = std::move(val);
+    } else if (depth == 2) {
+        fieldName = std::move(val);
+    } else {
+        nestedKey = std::move(val);
+    }
+    return true;
+}
+
+bool PlayerIngestHandler::parse_error(std::size_t, const std::string &last_token,
+                                      const nlohmann::detail::exception &ex) {
+    std::cerr << "JSON parse error in players data: " << ex.what() << std::endl;
+    std::cerr << "Near: " << last_token.substr(0, 100) << "..." << std::endl;
+    return false;
+}
+
+bool ingestPlayersJson(SQLite::Database &db, const std::string &jsonText, std::vector<std::string> &columns,
+                       PlayerChanges &changes, IngestMode mode) {
+    PlayerIngestHandler handler(db, mode);
+    if (!json::sax_parse(jsonText, &handler)) {
+        return false;
+    }
+    handler.finish();
+    createPlayerIndexes(db);
+    columns = handler.getColumns();
+    changes = handler.getChanges();
+    if (!changes.empty()) {
+        db.exec("INSERT INTO players_generation (id, generation) VALUES (1, 1) "
+                "ON CONFLICT(id) DO UPDATE SET generation = generation + 1");
+    }
+    return true;
+}
+
+int64_t playersGeneration(SQLite::Database &db) {
+    if (!db.tableExists("players_generation")) {
+        return 0;
+    }
+    return db.execAndGet("SELECT ifnull((SELECT generation FROM players_generation), 0)").getInt64();
+}
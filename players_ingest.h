@@ -0,0 +1,127 @@
+#ifndef PLAYERS_INGEST_H
+#define PLAYERS_INGEST_H
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+using json = nlohmann::json;
+
+// PRAGMA user_version of a database whose players table has typed columns
+constexpr int playersSchemaVersion = 1;
+
+enum class IngestMode {
+    Full,        // rewrite every player with INSERT OR REPLACE
+    Incremental, // skip players whose content hash is unchanged, upsert the rest, delete players that vanished
+    Bulk         // load every player into a fresh staging table with multi-row INSERTs, index it, then swap it in
+};
+
+// Player ids touched by an incremental sync, for later stages that only need to act on the delta
+struct PlayerChanges {
+    std::vector<std::string> inserted;
+    std::vector<std::string> updated;
+    std::vector<std::string> deleted;
+    size_t unchanged = 0;
+
+    bool empty() const { return inserted.empty() && updated.empty() && deleted.empty(); }
+};
+
+// SAX handler for the Sleeper players dump ({"<id>": {...player...}, ...}). Each player is bound into the
+// prepared INSERT as soon as its object closes, so only one record is held in memory at a time. Keys not
+// seen before widen the players table with ALTER TABLE ADD COLUMN, typed after the first non-null value
+// (INTEGER for integers and booleans, REAL, otherwise TEXT). An incremental sync of an empty table is run as a
+// bulk load, since there is nothing to diff against.
+class PlayerIngestHandler : public nlohmann::json_sax<json> {
+public:
+    explicit PlayerIngestHandler(SQLite::Database &db, IngestMode mode = IngestMode::Incremental);
+
+    const std::vector<std::string> &getColumns() const { return columns; }
+    size_t getRowCount() const { return rowCount; }
+    const PlayerChanges &getChanges() const { return changes; }
+
+    // Deletes players that were in the table but not in the document, or for a bulk load replaces the players
+    // table with the staging table. Only call after a successful parse.
+    void finish();
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t &s) override;
+    bool string(string_t &val) override;
+    bool binary(binary_t &val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t &val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string &last_token,
+                     const nlohmann::detail::exception &ex) override;
+
+private:
+    bool value(json val);
+    bool startContainer(json container);
+    bool endContainer();
+    int columnFor(const std::string &name, const json &val);
+    void prepareWrite();
+    size_t batchRows() const;
+    void prepareBatch(size_t rows);
+    void writeBatch();
+    void swapStagingTables();
+    uint64_t recordHash();
+    void flushRecord();
+
+    SQLite::Database &db;
+    IngestMode mode;
+    std::string table = "players";
+    std::string hashTable = "player_hashes";
+    std::vector<std::string> columns;
+    std::unordered_map<std::string, int> columnIndex;
+    std::unique_ptr<SQLite::Statement> insert;
+    std::unique_ptr<SQLite::Statement> storeHash;
+    size_t rowCount = 0;
+
+    // Hashes of the players currently in the table; entries are erased as players are seen again
+    std::unordered_map<std::string, uint64_t> knownHashes;
+    PlayerChanges changes;
+
+    int depth = 0;
+    std::string playerId;
+    std::string fieldName;
+    std::vector<std::pair<int, json>> record;
+
+    // Bulk mode buffers players until a multi-row INSERT of batchRows() rows can be written
+    struct PendingPlayer {
+        std::string id;
+        uint64_t hash;
+        std::vector<std::pair<int, json>> record;
+    };
+    std::vector<PendingPlayer> pending;
+    size_t batchSize = 0; // rows the prepared insert and storeHash statements take
+
+    // Arrays and objects nested inside a player field are rebuilt as JSON and stored as their dump()
+    json nestedRoot;
+    std::vector<json *> nested;
+    std::string nestedKey;
+};
+
+std::vector<std::string> loadPlayerColumns(SQLite::Database &db, const std::string &table = "players");
+
+// Indexes for the player filters used when loading the working set; columns that do not exist yet are skipped
+void createPlayerIndexes(SQLite::Database &db);
+
+// Streams a players dump into the players table inside the caller's transaction. Returns false if the
+// document could not be parsed, in which case the caller should roll back.
+bool ingestPlayersJson(SQLite::Database &db, const std::string &jsonText, std::vector<std::string> &columns,
+                       PlayerChanges &changes, IngestMode mode = IngestMode::Incremental);
+
+// Counts the syncs that changed at least one player; 0 before the first. Stages derived from the players compare
+// it to tell whether they are still current.
+int64_t playersGeneration(SQLite::Database &db);
+
+#endif // PLAYERS_INGEST_H
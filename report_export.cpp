@@ -0,0 +1,357 @@
+#include "report_export.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <string_view>
+#include <variant>
+
+#include "metrics.h"
+#include "text_normalize.h"
+
+
+struct ExportColumn {
+    const char *name;
+    bool integer;
+};
+
+// The processed_players columns an export can select, filter and sort on
+static constexpr ExportColumn exportColumns[] = {
+        {"league_id", false},
+        {"id", false},
+        {"full_name", false},
+        {"position", false},
+        {"nfl_team", false},
+        {"fantasy_team", false},
+        {"years_exp", true},
+        {"draft_year", true},
+        {"draft_round", true},
+        {"draft_pick", true},
+        {"draft_team", false},
+};
+
+static const ExportColumn *findColumn(std::string_view name) {
+    for (const auto &column: exportColumns) {
+        if (name == column.name) {
+            return &column;
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+static bool parseNumber(const std::string &text, T &value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+static std::vector<std::string> splitList(const std::string &value) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = std::min(value.find(',', start), value.size());
+        if (end > start) {
+            items.push_back(value.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+std::string parseExportQuery(const std::string &text, ExportQuery &query) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find_first_of("& \t\r\n", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string_view pair(text.data() + start, end - start);
+        start = end + 1;
+        if (pair.empty()) {
+            continue;
+        }
+
+        size_t equals = pair.find('=');
+        if (equals == std::string_view::npos) {
+            return "expected key=value, got " + std::string(pair);
+        }
+        std::string key(pair.substr(0, equals));
+        std::string value = percentDecode(pair.substr(equals + 1));
+        if (key == "league") {
+            query.leagues.push_back(value);
+        } else if (key == "position") {
+            query.position = value;
+        } else if (key == "nfl_team") {
+            query.nflTeam = value;
+        } else if (key == "team") {
+            query.fantasyTeam = value;
+        } else if (key == "from" || key == "to" || key == "max_round") {
+            int &target = key == "from" ? query.fromYear : key == "to" ? query.toYear : query.maxRound;
+            if (!parseNumber(value, target)) {
+                return "invalid number for " + key + ": " + value;
+            }
+        } else if (key == "limit") {
+            if (!parseNumber(value, query.limit) || query.limit < 0) {
+                return "invalid number for limit: " + value;
+            }
+        } else if (key == "columns") {
+            query.columns = splitList(value);
+            for (const auto &name: query.columns) {
+                if (!findColumn(name)) {
+                    return "unknown column " + name;
+                }
+            }
+        } else if (key == "sort") {
+            query.order.clear();
+            for (auto &name: splitList(value)) {
+                bool descending = name.starts_with('-');
+                if (descending) {
+                    name.erase(0, 1);
+                }
+                if (!findColumn(name)) {
+                    return "unknown column " + name;
+                }
+                query.order.emplace_back(name, descending);
+            }
+        } else {
+            return "unknown parameter " + key;
+        }
+    }
+    if (query.fromYear != 0 && query.toYear != 0 && query.fromYear > query.toYear) {
+        return "from is after to";
+    }
+    return "";
+}
+
+// Collects output in one large block and hands it to the stream whenever the block is full, so a row costs a few
+// appends and the export makes one write call per megabyte
+class ExportBuffer {
+public:
+    explicit ExportBuffer(FILE *out) : out(out) { buffer.reserve(capacity); }
+
+    void append(std::string_view text) {
+        if (buffer.size() + text.size() > capacity) {
+            flush();
+        }
+        buffer.append(text);
+    }
+
+    void push(char c) {
+        if (buffer.size() == capacity) {
+            flush();
+        }
+        buffer.push_back(c);
+    }
+
+    void appendInteger(int64_t value) {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        append(std::string_view(digits, (size_t) (end - digits)));
+    }
+
+    bool flush() {
+        if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+        return !failed;
+    }
+
+private:
+    static constexpr size_t capacity = 1 << 20;
+
+    FILE *out;
+    std::string buffer;
+    bool failed = false;
+};
+
+static void appendCsv(ExportBuffer &out, std::string_view value) {
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out.append(value);
+        return;
+    }
+    out.push('"');
+    for (char c: value) {
+        if (c == '"') {
+            out.push('"');
+        }
+        out.push(c);
+    }
+    out.push('"');
+}
+
+// UTF-8 is passed through; only quotes, backslashes and control characters are escaped
+static void appendJsonString(ExportBuffer &out, std::string_view value) {
+    static constexpr char hex[] = "0123456789abcdef";
+    out.push('"');
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        auto c = (unsigned char) value[i];
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        out.append(value.substr(start, i - start));
+        start = i + 1;
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                out.append("\\u00");
+                out.push(hex[c >> 4]);
+                out.push(hex[c & 15]);
+        }
+    }
+    out.append(value.substr(start));
+    out.push('"');
+}
+
+int64_t exportProcessedPlayers(SQLite::Database &db, const ExportQuery &query, ExportFormat format,
+                               const std::string &path) {
+    ScopedSpan span("export", "sqlite");
+
+    // Output columns are resolved to result indices once; rows are read by index
+    std::vector<const ExportColumn *> columns;
+    for (const auto &name: query.columns) {
+        columns.push_back(findColumn(name));
+    }
+    if (columns.empty()) {
+        for (const auto &column: exportColumns) {
+            columns.push_back(&column);
+        }
+    }
+
+    std::string sql = "SELECT ";
+    for (size_t i = 0; i < columns.size(); ++i) {
+        sql += (i > 0 ? ", " : "") + std::string(columns[i]->name);
+    }
+    sql += " FROM processed_players WHERE 1";
+
+    std::vector<std::variant<int64_t, std::string>> bindings;
+    auto where = [&](const char *condition, std::variant<int64_t, std::string> value) {
+        sql += " AND ";
+        sql += condition;
+        bindings.push_back(std::move(value));
+    };
+    if (!query.leagues.empty()) {
+        sql += " AND league_id IN (";
+        for (size_t i = 0; i < query.leagues.size(); ++i) {
+            sql += i > 0 ? ", ?" : "?";
+            bindings.emplace_back(query.leagues[i]);
+        }
+        sql += ")";
+    }
+    if (query.fromYear != 0) {
+        where("draft_year >= ?", (int64_t) query.fromYear);
+    }
+    if (query.toYear != 0) {
+        where("draft_year <= ?", (int64_t) query.toYear);
+    }
+    if (query.maxRound != 0) {
+        where("draft_round <= ?", (int64_t) query.maxRound);
+    }
+    if (!query.position.empty()) {
+        where("position = ?", query.position);
+    }
+    if (!query.nflTeam.empty()) {
+        where("nfl_team = ?", query.nflTeam);
+    }
+    if (!query.fantasyTeam.empty()) {
+        where("fantasy_team = ?", query.fantasyTeam);
+    }
+
+    sql += " ORDER BY ";
+    if (query.order.empty()) {
+        sql += "league_id, draft_year DESC, draft_round, draft_pick";
+    }
+    for (size_t i = 0; i < query.order.size(); ++i) {
+        sql += (i > 0 ? ", " : "") + query.order[i].first + (query.order[i].second ? " DESC" : "");
+    }
+    if (query.limit > 0) {
+        sql += " LIMIT ?";
+        bindings.emplace_back(query.limit);
+    }
+
+    bool toStdout = path == "-";
+    FILE *file = toStdout ? stdout : std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Cannot open export file " << path << std::endl;
+        return -1;
+    }
+
+    int64_t rows = 0;
+    bool written = false;
+    try {
+        SQLite::Statement select(db, sql);
+        for (size_t i = 0; i < bindings.size(); ++i) {
+            std::visit([&select, i](const auto &value) { select.bind((int) i + 1, value); }, bindings[i]);
+        }
+
+        ExportBuffer out(file);
+        if (format == ExportFormat::Csv) {
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (i > 0) {
+                    out.push(',');
+                }
+                out.append(columns[i]->name);
+            }
+            out.push('\n');
+        }
+
+        while (select.executeStep()) {
+            if (format == ExportFormat::Ndjson) {
+                out.push('{');
+            }
+            for (size_t i = 0; i < columns.size(); ++i) {
+                SQLite::Column column = select.getColumn((int) i);
+                if (i > 0) {
+                    out.push(',');
+                }
+                if (format == ExportFormat::Ndjson) {
+                    out.push('"');
+                    out.append(columns[i]->name);
+                    out.append("\":");
+                }
+                if (column.isNull()) {
+                    if (format == ExportFormat::Ndjson) {
+                        out.append("null");
+                    }
+                } else if (columns[i]->integer) {
+                    out.appendInteger(column.getInt64());
+                } else {
+                    std::string_view value(column.getText(), (size_t) column.getBytes());
+                    format == ExportFormat::Csv ? appendCsv(out, value) : appendJsonString(out, value);
+                }
+            }
+            out.append(format == ExportFormat::Ndjson ? "}\n" : "\n");
+            rows++;
+        }
+        written = out.flush() && std::fflush(file) == 0;
+    } catch (std::exception &e) {
+        std::cerr << "Error while exporting processed players: " << e.what() << std::endl;
+    }
+    if (!toStdout && std::fclose(file) != 0) {
+        written = false;
+    }
+    if (!written) {
+        std::cerr << "Failed to write export to " << path << std::endl;
+        return -1;
+    }
+
+    span.args = {{"rows", rows}, {"format", format == ExportFormat::Csv ? "csv" : "ndjson"}};
+    metrics.count("export.rows", rows);
+    return rows;
+}
@@ -0,0 +1,38 @@
+#ifndef REPORT_EXPORT_H
+#define REPORT_EXPORT_H
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+enum class ExportFormat { Csv, Ndjson };
+
+// Filters, columns and order of an export of processed_players. Zero and empty values do not filter.
+struct ExportQuery {
+    std::vector<std::string> leagues; // empty for every league
+    int fromYear = 0;
+    int toYear = 0;
+    int maxRound = 0;
+    std::string position;
+    std::string nflTeam;
+    std::string fantasyTeam;
+    std::vector<std::string> columns;                // empty for every column
+    std::vector<std::pair<std::string, bool>> order; // column, descending
+    int64_t limit = 0;
+};
+
+// Parses key=value pairs separated by '&' or spaces: league (repeatable), from, to, max_round, position,
+// nfl_team, team, columns and sort (comma-separated column names, '-' in front for descending) and limit.
+// Values may be percent-encoded. The default order is by league, newest draft first and pick order within a
+// draft. Returns an error message, or an empty string on success.
+std::string parseExportQuery(const std::string &text, ExportQuery &query);
+
+// Streams the matching rows to path ("-" for stdout) one at a time through a large write buffer, so memory use
+// does not grow with the result. Returns the number of rows written, or -1 if the export failed.
+int64_t exportProcessedPlayers(SQLite::Database &db, const ExportQuery &query, ExportFormat format,
+                               const std::string &path);
+
+#endif // REPORT_EXPORT_H
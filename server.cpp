@@ -0,0 +1,233 @@
+#include "server.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "fantasy.h"
+#include "metrics.h"
+#include "text_normalize.h"
+
+
+static bool parseInt(const std::string &text, int &value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+std::string parseReportQuery(const std::string &text, int currentYear, ReportQuery &query) {
+    query.fromYear = currentYear - 2;
+    query.toYear = currentYear;
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find_first_of("& \t\r\n", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string_view pair(text.data() + start, end - start);
+        start = end + 1;
+        if (pair.empty()) {
+            continue;
+        }
+
+        size_t equals = pair.find('=');
+        if (equals == std::string_view::npos) {
+            return "expected key=value, got " + std::string(pair);
+        }
+        std::string key(pair.substr(0, equals));
+        std::string value = percentDecode(pair.substr(equals + 1));
+        if (key == "league") {
+            query.league = value;
+        } else if (key == "position") {
+            query.position = value;
+        } else if (key == "team") {
+            query.fantasyTeam = value;
+        } else if (key == "from" || key == "to" || key == "max_round") {
+            int &target = key == "from" ? query.fromYear : key == "to" ? query.toYear : query.maxRound;
+            if (!parseInt(value, target)) {
+                return "invalid number for " + key + ": " + value;
+            }
+        } else {
+            return "unknown parameter " + key;
+        }
+    }
+    if (query.fromYear > query.toYear) {
+        return "from is after to";
+    }
+    return "";
+}
+
+nlohmann::json runReportQuery(const Snapshot &snapshot, const ReportQuery &query) {
+    std::optional<size_t> league = snapshot.findLeague(query.league);
+    if (query.league.empty() && snapshot.leagueCount() > 0) {
+        league = 0;
+    }
+    if (!league) {
+        return {{"error", "league " + query.league + " is not in the snapshot"}};
+    }
+
+    nlohmann::json players = nlohmann::json::array();
+    for (size_t i: snapshot.draftedSince(query.fromYear, query.maxRound)) {
+        std::string_view fantasyTeam = snapshot.fantasyTeam(*league, i);
+        if (snapshot.draftYear(i) > query.toYear || (!query.position.empty() && snapshot.position(i) != query.position) ||
+            (!query.fantasyTeam.empty() && fantasyTeam != query.fantasyTeam)) {
+            continue;
+        }
+        players.push_back({{"id", std::string(snapshot.id(i))},
+                           {"name", std::string(snapshot.fullName(i))},
+                           {"position", std::string(snapshot.position(i))},
+                           {"nfl_team", std::string(snapshot.nflTeam(i))},
+                           {"fantasy_team", std::string(fantasyTeam)},
+                           {"years_exp", snapshot.yearsExp(i)},
+                           {"draft_year", snapshot.draftYear(i)},
+                           {"draft_round", snapshot.draftRound(i)},
+                           {"draft_pick", snapshot.draftPick(i)},
+                           {"draft_team", std::string(snapshot.draftTeam(i))}});
+    }
+    return {{"league", std::string(snapshot.leagueId(*league))},
+            {"snapshot_created_at", snapshot.createdAt()},
+            {"from_year", query.fromYear},
+            {"to_year", query.toYear},
+            {"max_round", query.maxRound},
+            {"players", players}};
+}
+
+ReportServer::ReportServer(std::filesystem::path socketPath) : socketPath(std::move(socketPath)) {}
+
+ReportServer::~ReportServer() {
+    if (listener >= 0) {
+        close(listener);
+        std::error_code ec;
+        std::filesystem::remove(socketPath, ec);
+    }
+}
+
+void ReportServer::publish(std::shared_ptr<const Snapshot> snapshot) {
+    current.store(std::move(snapshot));
+}
+
+bool ReportServer::run(const std::atomic<bool> &stop) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::string path = socketPath.string();
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path " << socketPath << " is too long" << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket left behind by a server that did not shut down cleanly refuses connections; one that accepts
+    // them belongs to a running server and is left alone
+    std::error_code ec;
+    if (std::filesystem::is_socket(socketPath, ec)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool refused = probe >= 0 && connect(probe, (const sockaddr *) &address, sizeof(address)) != 0 &&
+                       errno == ECONNREFUSED;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (!refused) {
+            std::cerr << "Socket " << socketPath << " is in use by another server" << std::endl;
+            return false;
+        }
+        std::filesystem::remove(socketPath, ec);
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (const sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0) {
+        std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) {
+            // The path may belong to someone else, so the destructor must not remove it
+            close(listener);
+            listener = -1;
+        }
+        return false;
+    }
+    std::cout << "Serving reports on " << socketPath << std::endl;
+
+    // Queries take microseconds, so they are answered one at a time on this thread
+    while (!stop) {
+        pollfd ready{listener, POLLIN, 0};
+        if (poll(&ready, 1, 250) <= 0) {
+            continue; // timeouts and signals just re-check stop
+        }
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        handle(client);
+        close(client);
+    }
+    return true;
+}
+
+void ReportServer::handle(int client) {
+    ScopedSpan span("report_query", "server");
+
+    // A client that connects and sends nothing must not hold up everyone else
+    timeval timeout{2, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find('\n') == std::string::npos && request.size() < 8192) {
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        request.append(buffer, (size_t) received);
+    }
+
+    std::string line = request.substr(0, request.find('\n'));
+    bool http = line.starts_with("GET ");
+    if (http) {
+        // GET /report?league=...&max_round=2 HTTP/1.1
+        std::string target = line.substr(4, line.find(' ', 4) - 4);
+        size_t question = target.find('?');
+        line = question == std::string::npos ? "" : target.substr(question + 1);
+    }
+
+    nlohmann::json response;
+    int status = 200;
+    ReportQuery query;
+    std::shared_ptr<const Snapshot> snapshot = current.load();
+    if (std::string error = parseReportQuery(line, getCurrentYear(), query); !error.empty()) {
+        response = {{"error", error}};
+        status = 400;
+    } else if (!snapshot) {
+        response = {{"error", "no data yet, the first refresh is still running"}};
+        status = 503;
+    } else {
+        response = runReportQuery(*snapshot, query);
+        if (response.contains("error")) {
+            status = 404;
+        }
+    }
+    metrics.count("server.queries");
+
+    std::string body = response.dump() + "\n";
+    if (http) {
+        const char *reason = status == 200 ? "OK" : status == 400 ? "Bad Request"
+                                                  : status == 404 ? "Not Found"
+                                                                  : "Service Unavailable";
+        body = "HTTP/1.0 " + std::to_string(status) + " " + reason + "\r\n" +
+               "Content-Type: application/json\r\n" +
+               "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+               "Connection: close\r\n\r\n" + body;
+    }
+
+    size_t sent = 0;
+    while (sent < body.size()) {
+        ssize_t written = send(client, body.data() + sent, body.size() - sent, 0);
+        if (written <= 0) {
+            break;
+        }
+        sent += (size_t) written;
+    }
+}
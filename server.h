@@ -0,0 +1,51 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "snapshot.h"
+
+
+// Filters of one report query. Years are inclusive; an empty position or fantasy team matches every player.
+struct ReportQuery {
+    std::string league; // empty for the first league of the snapshot
+    int fromYear = 0;
+    int toYear = 0;
+    int maxRound = 3;
+    std::string position;
+    std::string fantasyTeam;
+};
+
+// Parses key=value pairs separated by '&' or spaces: league, from, to, max_round, position, team. Values may be
+// percent-encoded. Defaults are the last three drafts and rounds 1-3, like the interactive report. Returns an
+// error message, or an empty string on success.
+std::string parseReportQuery(const std::string &text, int currentYear, ReportQuery &query);
+
+nlohmann::json runReportQuery(const Snapshot &snapshot, const ReportQuery &query);
+
+// Serves report queries over a Unix socket from the most recently published snapshot. A connection sends either
+// one query line or an HTTP GET (/report?league=...) and gets one JSON document back. publish() swaps the
+// dataset atomically, so queries never wait for a refresh and a query in flight keeps the snapshot it started with.
+class ReportServer {
+public:
+    explicit ReportServer(std::filesystem::path socketPath);
+    ~ReportServer();
+
+    void publish(std::shared_ptr<const Snapshot> snapshot);
+
+    // Accepts connections until stop becomes true. Returns false if the socket could not be opened.
+    bool run(const std::atomic<bool> &stop);
+
+private:
+    void handle(int client);
+
+    std::filesystem::path socketPath;
+    int listener = -1;
+    std::atomic<std::shared_ptr<const Snapshot>> current;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,232 @@
+#include "snapshot.h"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static constexpr char snapshotMagic[8] = {'F', 'N', 'T', 'S', 'N', 'A', 'P', '\0'};
+static constexpr uint32_t snapshotByteOrder = 0x01020304;
+
+static_assert(sizeof(SnapshotPlayer) == 28);
+static_assert(sizeof(SnapshotLeague) == 16);
+
+static bool writeFileAtomically(const std::filesystem::path &path, const std::string &contents) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.write(contents.data(), (std::streamsize) contents.size())) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+SnapshotWriter::SnapshotWriter(const PlayerStore &players) {
+    intern(""); // code 0, like StringPool
+    records.reserve(players.size());
+    for (size_t i = 0; i < players.size(); ++i) {
+        SnapshotPlayer record{};
+        record.id = intern(players.id(i));
+        record.fullName = intern(players.fullName(i));
+        record.position = intern(players.position(i));
+        record.nflTeam = intern(players.nflTeam(i));
+        record.draftTeam = intern(players.draftTeam(i));
+        record.yearsExp = (int16_t) players.yearsExp(i);
+        record.draftYear = (int16_t) players.draftYear(i);
+        record.draftPick = (uint16_t) players.draftPick(i);
+        record.draftRound = (uint8_t) players.draftRound(i);
+        records.push_back(record);
+    }
+
+    // Every drafted player, so any year and round filter is a prefix walk at read time
+    for (size_t i: players.draftedSince(0, UINT8_MAX)) {
+        draftOrder.push_back((uint32_t) i);
+    }
+}
+
+uint32_t SnapshotWriter::intern(std::string_view value) {
+    auto [it, inserted] = codes.try_emplace(std::string(value), (uint32_t) strings.size());
+    if (inserted) {
+        strings.emplace_back(value);
+    }
+    return it->second;
+}
+
+void SnapshotWriter::addLeague(const std::string &league_id, const PlayerStore &players) {
+    std::vector<uint32_t> teams;
+    teams.reserve(players.size());
+    for (size_t i = 0; i < players.size(); ++i) {
+        teams.push_back(intern(players.fantasyTeam(i)));
+    }
+    leagues.emplace_back(intern(league_id), std::move(teams));
+}
+
+bool SnapshotWriter::write(const std::filesystem::path &path) const {
+    std::string out(sizeof(SnapshotHeader), '\0');
+    auto align = [&out] { out.resize((out.size() + 7) & ~(size_t) 7, '\0'); };
+    auto append = [&out](const void *data, size_t size) { out.append((const char *) data, size); };
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.byteOrder = snapshotByteOrder;
+    header.playerCount = (uint32_t) records.size();
+    header.draftedCount = (uint32_t) draftOrder.size();
+    header.leagueCount = (uint32_t) leagues.size();
+    header.stringCount = (uint32_t) strings.size();
+    header.createdAt = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<uint32_t> offsets{0};
+    for (const auto &value: strings) {
+        offsets.push_back(offsets.back() + (uint32_t) value.size());
+    }
+    align();
+    header.stringOffsets = out.size();
+    append(offsets.data(), offsets.size() * sizeof(uint32_t));
+    header.stringData = out.size();
+    for (const auto &value: strings) {
+        out += value;
+    }
+
+    align();
+    header.players = out.size();
+    append(records.data(), records.size() * sizeof(SnapshotPlayer));
+    align();
+    header.draftOrder = out.size();
+    append(draftOrder.data(), draftOrder.size() * sizeof(uint32_t));
+
+    align();
+    header.leagues = out.size();
+    std::vector<SnapshotLeague> leagueRecords(leagues.size());
+    out.resize(out.size() + leagueRecords.size() * sizeof(SnapshotLeague), '\0');
+    for (size_t i = 0; i < leagues.size(); ++i) {
+        align();
+        leagueRecords[i].id = leagues[i].first;
+        leagueRecords[i].fantasyTeams = out.size();
+        append(leagues[i].second.data(), leagues[i].second.size() * sizeof(uint32_t));
+    }
+    std::memcpy(out.data() + header.leagues, leagueRecords.data(), leagueRecords.size() * sizeof(SnapshotLeague));
+
+    header.fileSize = out.size();
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    if (!writeFileAtomically(path, out)) {
+        std::cerr << "Failed to write snapshot " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+Snapshot::~Snapshot() {
+    close();
+}
+
+void Snapshot::close() {
+    if (base) {
+        munmap((void *) base, length);
+    }
+    base = nullptr;
+    length = 0;
+    header = nullptr;
+}
+
+bool Snapshot::fits(uint64_t offset, uint64_t count, size_t size) const {
+    return offset % 8 == 0 && offset <= length && count <= (length - offset) / size;
+}
+
+bool Snapshot::open(const std::filesystem::path &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open snapshot " << path << std::endl;
+        return false;
+    }
+    struct stat info{};
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(SnapshotHeader)) {
+        mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Cannot map snapshot " << path << std::endl;
+        return false;
+    }
+    base = (const char *) mapped;
+    length = (size_t) info.st_size;
+    header = (const SnapshotHeader *) base;
+
+    bool valid = std::memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) == 0 &&
+                 header->version == snapshotVersion && header->byteOrder == snapshotByteOrder &&
+                 header->fileSize == length && fits(header->stringOffsets, header->stringCount + 1ULL, 4) &&
+                 fits(header->players, header->playerCount, sizeof(SnapshotPlayer)) &&
+                 fits(header->draftOrder, header->draftedCount, sizeof(uint32_t)) &&
+                 fits(header->leagues, header->leagueCount, sizeof(SnapshotLeague));
+    if (valid) {
+        stringOffsets = (const uint32_t *) (base + header->stringOffsets);
+        stringData = base + header->stringData;
+        records = (const SnapshotPlayer *) (base + header->players);
+        draftOrder = (const uint32_t *) (base + header->draftOrder);
+        leagueRecords = (const SnapshotLeague *) (base + header->leagues);
+        valid = header->stringData <= length &&
+                stringOffsets[header->stringCount] <= length - header->stringData;
+        for (size_t league = 0; valid && league < header->leagueCount; ++league) {
+            valid = fits(leagueRecords[league].fantasyTeams, header->playerCount, sizeof(uint32_t));
+        }
+    }
+    if (!valid) {
+        std::cerr << "Snapshot " << path << " is damaged or from another version; run once to rewrite it" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+std::string_view Snapshot::string(uint32_t code) const {
+    if (code >= header->stringCount || stringOffsets[code] > stringOffsets[code + 1] ||
+        stringOffsets[code + 1] > stringOffsets[header->stringCount]) {
+        return {};
+    }
+    return {stringData + stringOffsets[code], stringOffsets[code + 1] - stringOffsets[code]};
+}
+
+std::optional<size_t> Snapshot::findLeague(std::string_view league_id) const {
+    for (size_t league = 0; league < header->leagueCount; ++league) {
+        if (leagueId(league) == league_id) {
+            return league;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view Snapshot::fantasyTeam(size_t league, size_t i) const {
+    auto *teams = (const uint32_t *) (base + leagueRecords[league].fantasyTeams);
+    return string(teams[i]);
+}
+
+std::vector<size_t> Snapshot::draftedSince(int fromYear, int maxRound) const {
+    std::vector<size_t> selected;
+    for (size_t n = 0; n < header->draftedCount; ++n) {
+        uint32_t i = draftOrder[n];
+        if (i >= header->playerCount) {
+            continue;
+        }
+        if (records[i].draftYear < fromYear) {
+            break;
+        }
+        if (records[i].draftRound <= maxRound) {
+            selected.push_back(i);
+        }
+    }
+    return selected;
+}
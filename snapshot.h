@@ -0,0 +1,127 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "player_store.h"
+
+
+constexpr uint32_t snapshotVersion = 1;
+
+// On-disk layout. The file is used in place through mmap, so the records are fixed-size structs in host byte
+// order; byteOrder and the version reject files written by an incompatible build. Offsets are from the start of
+// the file and every section is 8-byte aligned.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written
+    uint32_t playerCount;
+    uint32_t draftedCount;
+    uint32_t leagueCount;
+    uint32_t stringCount;
+    int64_t createdAt;      // unix seconds
+    uint64_t stringOffsets; // uint32_t[stringCount + 1], byte offsets into the string data
+    uint64_t stringData;
+    uint64_t players;    // SnapshotPlayer[playerCount]
+    uint64_t draftOrder; // uint32_t[draftedCount], drafted players newest draft first and by pick within a year
+    uint64_t leagues;    // SnapshotLeague[leagueCount]
+    uint64_t fileSize;
+};
+
+// Strings are stored once and referenced by their code
+struct SnapshotPlayer {
+    uint32_t id;
+    uint32_t fullName;
+    uint32_t position;
+    uint32_t nflTeam;
+    uint32_t draftTeam;
+    int16_t yearsExp;
+    int16_t draftYear; // 0 while undrafted
+    uint16_t draftPick;
+    uint8_t draftRound;
+    uint8_t reserved;
+};
+
+struct SnapshotLeague {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t fantasyTeams; // uint32_t[playerCount] string codes
+};
+
+// Collects the processed working set of a run (players, draft info and each league's fantasy teams) and writes
+// it as one snapshot file.
+class SnapshotWriter {
+public:
+    // Takes the player and draft columns as they are now, so construct it once drafts have been applied
+    explicit SnapshotWriter(const PlayerStore &players);
+
+    // Records the fantasy teams players currently holds for this league
+    void addLeague(const std::string &league_id, const PlayerStore &players);
+
+    // Writes to a temporary file and renames it over path, so readers never see a partial snapshot
+    bool write(const std::filesystem::path &path) const;
+
+private:
+    uint32_t intern(std::string_view value);
+
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> codes;
+    std::vector<SnapshotPlayer> records;
+    std::vector<uint32_t> draftOrder;
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> leagues;
+};
+
+// Read-only view of a mapped snapshot. open() only checks the header and the section bounds; the accessors read
+// the mapped records directly.
+class Snapshot {
+public:
+    Snapshot() = default;
+    ~Snapshot();
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    bool open(const std::filesystem::path &path);
+    void close();
+
+    int64_t createdAt() const { return header->createdAt; }
+    size_t leagueCount() const { return header->leagueCount; }
+    std::string_view leagueId(size_t league) const { return string(leagueRecords[league].id); }
+    std::optional<size_t> findLeague(std::string_view league_id) const;
+
+    size_t size() const { return header->playerCount; }
+    std::string_view id(size_t i) const { return string(records[i].id); }
+    std::string_view fullName(size_t i) const { return string(records[i].fullName); }
+    std::string_view position(size_t i) const { return string(records[i].position); }
+    std::string_view nflTeam(size_t i) const { return string(records[i].nflTeam); }
+    std::string_view fantasyTeam(size_t league, size_t i) const;
+    int yearsExp(size_t i) const { return records[i].yearsExp; }
+    bool isDrafted(size_t i) const { return records[i].draftYear != 0; }
+    int draftYear(size_t i) const { return records[i].draftYear; }
+    int draftRound(size_t i) const { return records[i].draftRound; }
+    int draftPick(size_t i) const { return records[i].draftPick; }
+    std::string_view draftTeam(size_t i) const { return string(records[i].draftTeam); }
+
+    // Same selection and order as PlayerStore::draftedSince(), read off the stored draft order
+    std::vector<size_t> draftedSince(int fromYear, int maxRound) const;
+
+private:
+    std::string_view string(uint32_t code) const;
+    bool fits(uint64_t offset, uint64_t count, size_t size) const;
+
+    const char *base = nullptr;
+    size_t length = 0;
+    const SnapshotHeader *header = nullptr;
+    const uint32_t *stringOffsets = nullptr;
+    const char *stringData = nullptr;
+    const SnapshotPlayer *records = nullptr;
+    const uint32_t *draftOrder = nullptr;
+    const SnapshotLeague *leagueRecords = nullptr;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,184 @@
+// Checks NameIndex::findFirst against the matcher it replaced: scanning the names in order and stopping at the
+// first namesMatch(). Queries are the bench fixture player names, the fixture draft picks and randomized names
+// built from their tokens; a second round also indexes randomized names, including empty ones. Exits non-zero on
+// the first mismatch.
+//
+//     name_index_test [--fixtures DIR] [--seed N]
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../draft_parser.h"
+#include "../name_matching.h"
+
+
+#ifndef FIXTURE_DIR
+#define FIXTURE_DIR "bench/fixtures"
+#endif
+
+namespace fs = std::filesystem;
+
+static const int fixtureYears[] = {2022, 2023, 2024};
+
+static std::string readFile(const fs::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("missing fixture " + path.string());
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static int bruteForceFirst(const std::vector<std::string> &names, const std::string &query) {
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (namesMatch(names[i], query)) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+// Builds names the way they show up in the wild: shuffled and partial token lists, suffixes, stray punctuation,
+// mixed case, accents and irregular whitespace
+class NameGenerator {
+public:
+    NameGenerator(const std::vector<std::string> &names, unsigned seed) : random(seed) {
+        for (const auto &name: names) {
+            std::istringstream words(name);
+            for (std::string word; words >> word;) {
+                tokens.push_back(word);
+            }
+        }
+        tokens.insert(tokens.end(), {"Jr.", "III", "II", "Sr.", "José", "D'Andre", "St.", "A.J.", "Mc-Kay", "Ngata"});
+    }
+
+    std::string next() {
+        static const char *separators[] = {" ", " ", " ", "  ", "\t", "\xC2\xA0", ". ", "-"};
+        std::string name;
+        int count = pick(5);
+        for (int i = 0; i < count; ++i) {
+            if (i > 0) {
+                name += separators[pick(std::size(separators))];
+            }
+            std::string token = tokens[pick(tokens.size())];
+            switch (pick(6)) {
+                case 0:
+                    for (auto &c: token) {
+                        c = (char) std::toupper((unsigned char) c);
+                    }
+                    break;
+                case 1:
+                    for (auto &c: token) {
+                        c = (char) std::tolower((unsigned char) c);
+                    }
+                    break;
+                case 2:
+                    token += "*";
+                    break;
+                default:
+                    break;
+            }
+            name += token;
+        }
+        if (pick(4) == 0) {
+            name = " " + name + " ";
+        }
+        return name;
+    }
+
+    size_t pick(size_t bound) { return std::uniform_int_distribution<size_t>(0, bound - 1)(random); }
+
+private:
+    std::mt19937 random;
+    std::vector<std::string> tokens;
+};
+
+static bool check(const char *round, const std::vector<std::string> &names, const NameIndex &index,
+                  const std::vector<std::string> &queries) {
+    for (const auto &query: queries) {
+        int expected = bruteForceFirst(names, query);
+        int actual = index.findFirst(query);
+        if (actual != expected) {
+            std::cerr << round << ": findFirst(\"" << query << "\") returned " << actual << " ("
+                      << (actual >= 0 ? names[(size_t) actual] : "none") << "), the in-order scan " << expected << " ("
+                      << (expected >= 0 ? names[(size_t) expected] : "none") << ")" << std::endl;
+            return false;
+        }
+    }
+    std::cout << round << ": " << queries.size() << " queries over " << names.size() << " names match" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    fs::path fixtureDir = FIXTURE_DIR;
+    unsigned seed = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--fixtures" && i + 1 < argc) {
+            fixtureDir = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = (unsigned) std::stoul(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--fixtures DIR] [--seed N]" << std::endl;
+            return 2;
+        }
+    }
+
+    try {
+        std::vector<std::string> names;
+        for (const auto &player: nlohmann::json::parse(readFile(fixtureDir / "players_nfl.json"))) {
+            names.push_back(player.value("full_name", ""));
+        }
+        std::vector<std::string> picks;
+        for (int year: fixtureYears) {
+            parseDraftTable(year, readFile(fixtureDir / (std::to_string(year) + "_NFL_draft.html")),
+                            [&picks](const DraftPick &pick) { picks.push_back(pick.player_name); });
+        }
+        if (names.empty() || picks.empty()) {
+            std::cerr << "No player names or picks in " << fixtureDir << std::endl;
+            return 1;
+        }
+
+        NameIndex index;
+        index.build(names);
+        NameGenerator generator(names, seed);
+        std::vector<std::string> randomized{"", " ", "*"};
+        for (int i = 0; i < 2000; ++i) {
+            randomized.push_back(generator.next());
+        }
+        if (!check("player names", names, index, names) || !check("draft picks", names, index, picks) ||
+            !check("randomized queries", names, index, randomized)) {
+            return 1;
+        }
+
+        // Small randomized lists hit duplicates, empty names and subset chains far more often
+        for (int round = 0; round < 20; ++round) {
+            std::vector<std::string> randomNames;
+            size_t count = 20 + generator.pick(300);
+            for (size_t i = 0; i < count; ++i) {
+                randomNames.push_back(generator.pick(50) == 0 ? "" : generator.next());
+            }
+            NameIndex randomIndex;
+            randomIndex.build(randomNames);
+            std::vector<std::string> queries = randomNames;
+            for (int i = 0; i < 500; ++i) {
+                queries.push_back(generator.next());
+            }
+            if (!check("randomized names", randomNames, randomIndex, queries)) {
+                return 1;
+            }
+        }
+
+    } catch (std::exception &e) {
+        std::cerr << "Test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
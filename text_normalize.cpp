@@ -0,0 +1,145 @@
+#include "text_normalize.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+
+// ASCII folding for U+00C0..U+017F; nullptr entries are copied through unchanged
+static constexpr const char *latinFold[] = {
+        "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i", // U+00C0
+        "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "ss", // U+00D0
+        "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i", // U+00E0
+        "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "y", // U+00F0
+        "a", "a", "a", "a", "a", "a", "c", "c", "c", "c", "c", "c", "c", "c", "d", "d", // U+0100
+        "d", "d", "e", "e", "e", "e", "e", "e", "e", "e", "e", "e", "g", "g", "g", "g", // U+0110
+        "g", "g", "g", "g", "h", "h", "h", "h", "i", "i", "i", "i", "i", "i", "i", "i", // U+0120
+        "i", "i", "ij", "ij", "j", "j", "k", "k", "k", "l", "l", "l", "l", "l", "l", "l", // U+0130
+        "l", "l", "l", "n", "n", "n", "n", "n", "n", "n", "n", "n", "o", "o", "o", "o", // U+0140
+        "o", "o", "oe", "oe", "r", "r", "r", "r", "r", "r", "s", "s", "s", "s", "s", "s", // U+0150
+        "s", "s", "t", "t", "t", "t", "t", "t", "u", "u", "u", "u", "u", "u", "u", "u", // U+0160
+        "u", "u", "u", "u", "w", "w", "y", "y", "y", "z", "z", "z", "z", "z", "z", "s", // U+0170
+};
+
+static bool isAsciiSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static size_t utf8Length(unsigned char lead) {
+    if (lead < 0x80)
+        return 1;
+    if ((lead & 0xE0) == 0xC0)
+        return 2;
+    if ((lead & 0xF0) == 0xE0)
+        return 3;
+    if ((lead & 0xF8) == 0xF0)
+        return 4;
+    return 1; // stray continuation byte, copied as-is
+}
+
+template<bool FoldName>
+static void normalize(std::string_view in, std::string &out) {
+    out.clear();
+    bool pendingSpace = false;
+
+    auto emit = [&](std::string_view bytes) {
+        if (pendingSpace && !out.empty()) {
+            out.push_back(' ');
+        }
+        pendingSpace = false;
+        out.append(bytes);
+    };
+
+    size_t i = 0;
+    while (i < in.size()) {
+        unsigned char c = in[i];
+
+        if (isAsciiSpace(c)) {
+            pendingSpace = true;
+            i++;
+            continue;
+        }
+
+        if (c == '<') {
+            size_t close = in.find('>', i + 1);
+            if (close != std::string_view::npos) {
+                i = close + 1;
+                continue;
+            }
+        }
+
+        if (c == '&') {
+            std::string_view rest = in.substr(i);
+            if (rest.starts_with("&nbsp;") || rest.starts_with("&#160;")) {
+                pendingSpace = true;
+                i += 6;
+                continue;
+            }
+            if (rest.starts_with("&amp;")) {
+                emit("&");
+                i += 5;
+                continue;
+            }
+        }
+
+        if (c == '*') {
+            i++;
+            continue;
+        }
+
+        if (c < 0x80) {
+            char lower = FoldName && c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : (char) c;
+            emit(std::string_view(&lower, 1));
+            i++;
+            continue;
+        }
+
+        size_t length = std::min(utf8Length(c), in.size() - i);
+        std::string_view sequence = in.substr(i, length);
+        i += length;
+
+        if (sequence == "\xC2\xA0") { // no-break space
+            pendingSpace = true;
+            continue;
+        }
+        if (sequence == "\xE2\x80\xA0" || sequence == "\xE2\x80\xA1") { // dagger, double dagger
+            continue;
+        }
+
+        if constexpr (FoldName) {
+            if (length == 2) {
+                unsigned codePoint = ((c & 0x1F) << 6) | ((unsigned char) sequence[1] & 0x3F);
+                if (codePoint >= 0xC0 && codePoint < 0x180 && latinFold[codePoint - 0xC0] != nullptr) {
+                    emit(latinFold[codePoint - 0xC0]);
+                    continue;
+                }
+            } else if (sequence == "\xE2\x80\x98" || sequence == "\xE2\x80\x99") { // curly apostrophes
+                emit("'");
+                continue;
+            }
+        }
+        emit(sequence);
+    }
+}
+
+void normalizeText(std::string_view in, std::string &out) { normalize<false>(in, out); }
+
+void normalizeName(std::string_view in, std::string &out) { normalize<true>(in, out); }
+
+std::string percentDecode(std::string_view text) {
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            decoded += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && std::isxdigit((unsigned char) text[i + 1]) &&
+                   std::isxdigit((unsigned char) text[i + 2])) {
+            int byte = 0;
+            std::from_chars(text.data() + i + 1, text.data() + i + 3, byte, 16);
+            decoded += (char) byte;
+            i += 2;
+        } else {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
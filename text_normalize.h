@@ -0,0 +1,20 @@
+#ifndef TEXT_NORMALIZE_H
+#define TEXT_NORMALIZE_H
+
+#include <string>
+#include <string_view>
+
+
+// Single-pass cleanup of scraped cell text into out, reusing its capacity: whitespace runs (including
+// non-breaking spaces) collapse to one space, the ends are trimmed, and HTML tags, &nbsp;/&amp; entities
+// and footnote markers (†, ‡, *) are removed.
+void normalizeText(std::string_view in, std::string &out);
+
+// normalizeText that also lowercases and folds Latin-1/Latin Extended-A letters to ASCII ("José" -> "jose"),
+// so names compare equal regardless of case and accents. Other UTF-8 sequences are copied through intact.
+void normalizeName(std::string_view in, std::string &out);
+
+// Decodes %XX escapes and '+' as used in query strings; malformed escapes are kept as they are
+std::string percentDecode(std::string_view text);
+
+#endif // TEXT_NORMALIZE_H